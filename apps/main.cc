@@ -1,32 +1,421 @@
-#include <kaleidoscope/jit_interpreter.h>
+#include <kaleidoscope/ast/compilation_unit.h>
+#include <kaleidoscope/diagnostic.h>
+#include <kaleidoscope/jit_options.h>
 #include <kaleidoscope/lexer_error.h>
 #include <kaleidoscope/lexer_impl.h>
 #include <kaleidoscope/parser.h>
+#include <kaleidoscope/simplifier.h>
+#include <kaleidoscope/source_buffer.h>
+#include <kaleidoscope/symbol_table.h>
+#include <kaleidoscope/time_trace.h>
+#ifdef KALEIDOSCOPE_BACKEND_VM
+#include <kaleidoscope/vm_interpreter.h>
+#else
+#include <kaleidoscope/aot_compiler.h>
+#include <kaleidoscope/jit_interpreter.h>
+#endif
 
+#include <charconv>
+#include <chrono>
 #include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
 
-using kaleidoscope::JitInterpreter;
+using kaleidoscope::Diagnostic;
+using kaleidoscope::DiagnosticSeverity;
+using kaleidoscope::FastMathFlags;
+using kaleidoscope::FormatDiagnostic;
+using kaleidoscope::JitOptions;
 using kaleidoscope::LexerImpl;
 using kaleidoscope::LexerError;
-using kaleidoscope::ast::BaseExpression;
-using kaleidoscope::parser::ParseNextExpression;
+using kaleidoscope::OptimizationLevel;
+using kaleidoscope::SourceBuffer;
+using kaleidoscope::SymbolTable;
+using kaleidoscope::ast::CompilationUnit;
+using kaleidoscope::parser::ParseCompilationUnit;
+using kaleidoscope::parser::ParseCompilationUnitInParallel;
+using kaleidoscope::simplifier::SimplifyCompilationUnit;
+namespace time_trace = kaleidoscope::time_trace;
+
+#ifdef KALEIDOSCOPE_BACKEND_VM
+using Interpreter = kaleidoscope::VmInterpreter;
+#else
+using Interpreter = kaleidoscope::JitInterpreter;
+using kaleidoscope::AotCompiler;
+using kaleidoscope::AotOptions;
+using kaleidoscope::ObjectCacheStats;
+#endif
+
+namespace
+{
+const std::string_view kCacheDirFlag = "-cache-dir=";
+const std::string_view kCompileThreadsFlag = "-compile-threads=";
+const std::string_view kEmitHeaderFlag = "-emit-header=";
+const std::string_view kEmitLibFlag = "-emit-lib=";
+const std::string_view kEmitObjFlag = "-emit-obj=";
+const std::string_view kFastMathFlag = "-fast-math=";
+const std::string_view kInlineThresholdFlag = "-inline-threshold=";
+const std::string_view kMemoizeFlag = "-memoize=";
+const std::string_view kParseThreadsFlag = "-parse-threads=";
+const std::string_view kTierUpFlag = "-tier-up=";
+const std::string_view kTimeTraceFlag = "-time-trace=";
+const std::string_view kTimeTraceGranularityFlag = "-time-trace-granularity=";
+
+std::optional<OptimizationLevel> ParseOptimizationLevel(std::string_view arg)
+{
+    if (arg == "-O0") return OptimizationLevel::kO0;
+    if (arg == "-O1") return OptimizationLevel::kO1;
+    if (arg == "-O2") return OptimizationLevel::kO2;
+    if (arg == "-O3") return OptimizationLevel::kO3;
+    return std::nullopt;
+}
+
+void PrintUsage(const char* program)
+{
+    std::cerr << "Usage: " << program
+              << " [-O0|-O1|-O2|-O3] [-lazy] [-redefine] [-cache-dir=<dir>]"
+                 " [-compile-threads=<n>] [-parse-threads=<n>] [-tier-up=<n>]"
+                 " [-inline-threshold=<n>]"
+                 " [-memoize=<name>[,<name>...]]"
+                 " [-fast-math=<contract|reassoc|nnan|ninf|all>[,...]]"
+                 " [-emit-obj=<file>] [-emit-lib=<file>] [-emit-header=<file>]"
+                 " [-host-cpu] [-syntax-only]"
+                 " [-time-trace=<file>] [-time-trace-granularity=<us>]"
+                 " [file]\n";
+}
+
+// Non-empty items of a comma separated list.
+std::vector<std::string_view> SplitList(std::string_view list)
+{
+    std::vector<std::string_view> items;
+    while (!list.empty()) {
+        const size_t comma = list.find(',');
+        if (comma != 0) items.push_back(list.substr(0, comma));
+        if (comma == std::string_view::npos) break;
+        list.remove_prefix(comma + 1);
+    }
+    return items;
+}
+
+bool ParseFastMathFlags(std::string_view list, FastMathFlags* flags)
+{
+    for (std::string_view flag : SplitList(list)) {
+        const bool all = flag == "all";
+        if (!all && flag != "contract" && flag != "reassoc" &&
+            flag != "nnan" && flag != "ninf") {
+            return false;
+        }
+        flags->Contract |= all || flag == "contract";
+        flags->Reassoc |= all || flag == "reassoc";
+        flags->NoNaNs |= all || flag == "nnan";
+        flags->NoInfs |= all || flag == "ninf";
+    }
+    return true;
+}
+
+bool ParseUnsigned(std::string_view text, unsigned* value)
+{
+    const char* end = text.data() + text.size();
+    auto [ptr, ec] = std::from_chars(text.data(), end, *value);
+    return ec == std::errc() && ptr == end && !text.empty();
+}
 
-int main()
+void PrintResults(const std::vector<std::optional<double>>& results)
 {
-    JitInterpreter interpreter;
+    for (const std::optional<double>& result : results) {
+        if (result) std::cout << "Evaluated to " << *result << '\n';
+    }
+}
+
+// Loads the whole file as a single compilation unit and compiles it as a
+// batch. "-" reads the standard input.
+int RunBatch(Interpreter& interpreter, const std::string& path,
+             unsigned parse_threads)
+{
+    auto source = SourceBuffer::FromFile(path);
+    if (!source) {
+        std::cerr << "Could not open " << path << ": "
+                  << source.error().message() << '\n';
+        return 1;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    CompilationUnit unit;
+    if (parse_threads > 1) {
+        unit = ParseCompilationUnitInParallel(
+            source->Contents(), &interpreter.GetSymbolTable(), parse_threads);
+    } else {
+        LexerImpl lex(std::move(*source));
+        unit = ParseCompilationUnit(&lex, &interpreter.GetSymbolTable());
+    }
+    SimplifyCompilationUnit(&unit);
+    const auto parsed = std::chrono::steady_clock::now();
+    PrintResults(interpreter.EvaluateUnit(unit));
+    const auto compiled = std::chrono::steady_clock::now();
+
+    using Seconds = std::chrono::duration<double>;
+    const double parse_time = Seconds(parsed - start).count();
+    const double total_time = Seconds(compiled - start).count();
+    std::cerr << "Parsed " << unit.Items.size() << " items in "
+              << parse_time * 1000 << " ms, compiled and ran them in "
+              << (total_time - parse_time) * 1000 << " ms ("
+              << unit.Items.size() / total_time << " items/s)\n";
+    return 0;
+}
+
+// Only parses the file, and reports every syntax error in it. Fails if
+// there is any.
+int RunSyntaxCheck(const std::string& path, unsigned parse_threads)
+{
+    auto source = SourceBuffer::FromFile(path);
+    if (!source) {
+        std::cerr << "Could not open " << path << ": "
+                  << source.error().message() << '\n';
+        return 1;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    SymbolTable symbols;
+    std::vector<Diagnostic> diagnostics;
+    CompilationUnit unit;
+    if (parse_threads > 1) {
+        unit = ParseCompilationUnitInParallel(source->Contents(), &symbols,
+                                              parse_threads, &diagnostics);
+    } else {
+        LexerImpl lex(std::move(*source));
+        unit = ParseCompilationUnit(&lex, &symbols, &diagnostics);
+    }
+    const auto parsed = std::chrono::steady_clock::now();
+
+    size_t errors = 0;
+    for (const Diagnostic& diagnostic : diagnostics) {
+        std::cerr << path << ':' << FormatDiagnostic(diagnostic) << '\n';
+        if (diagnostic.Severity == DiagnosticSeverity::kError) ++errors;
+    }
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+    std::cerr << "Parsed " << unit.Items.size() << " items in "
+              << Milliseconds(parsed - start).count() << " ms, " << errors
+              << " errors\n";
+    return errors == 0 ? 0 : 1;
+}
+
+// Output files of ahead-of-time compilation, empty for those not wanted.
+struct AotOutputs {
+    std::string Object;
+    std::string Archive;
+    std::string Header;
 
+    bool Any() const
+    {
+        return !Object.empty() || !Archive.empty() || !Header.empty();
+    }
+};
+
+#ifndef KALEIDOSCOPE_BACKEND_VM
+// Compiles the definitions of the file into the requested outputs instead
+// of running anything.
+int RunAot(const AotOptions& options, const AotOutputs& outputs,
+           const std::string& path, unsigned parse_threads)
+{
+    auto source = SourceBuffer::FromFile(path);
+    if (!source) {
+        std::cerr << "Could not open " << path << ": "
+                  << source.error().message() << '\n';
+        return 1;
+    }
+
+    AotCompiler compiler(options);
+    CompilationUnit unit;
+    if (parse_threads > 1) {
+        unit = ParseCompilationUnitInParallel(
+            source->Contents(), &compiler.GetSymbolTable(), parse_threads);
+    } else {
+        LexerImpl lex(std::move(*source));
+        unit = ParseCompilationUnit(&lex, &compiler.GetSymbolTable());
+    }
+    SimplifyCompilationUnit(&unit);
+    if (!compiler.AddUnit(unit)) return 1;
+
+    if (!outputs.Object.empty() && !compiler.WriteObject(outputs.Object)) {
+        return 1;
+    }
+    if (!outputs.Archive.empty() && !compiler.WriteArchive(outputs.Archive)) {
+        return 1;
+    }
+    if (!outputs.Header.empty() && !compiler.WriteHeader(outputs.Header)) {
+        return 1;
+    }
+    return 0;
+}
+#endif
+
+void RunInteractive(Interpreter& interpreter)
+{
     while (true) {
         std::cout << "Eval > ";
         std::string input;
-        getline(std::cin, input);
-        if (input == "quit") break;
+        if (!getline(std::cin, input) || input == "quit") break;
         if (input.empty()) continue;
 
         LexerImpl lex(std::move(input));
-        if (std::unique_ptr<BaseExpression> expr = ParseNextExpression(&lex)) {
-            interpreter.EvaluateExpression(expr.get());
+        CompilationUnit unit =
+            ParseCompilationUnit(&lex, &interpreter.GetSymbolTable());
+        SimplifyCompilationUnit(&unit);
+        PrintResults(interpreter.EvaluateUnit(unit));
+    }
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    JitOptions options;
+    bool aot_host_cpu = false;
+    bool syntax_only = false;
+    AotOutputs aot_outputs;
+    std::optional<std::string> batch_file;
+    std::optional<std::string> time_trace_file;
+    unsigned time_trace_granularity_us = 500;
+    unsigned parse_threads = 0;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg(argv[i]);
+        if (auto level = ParseOptimizationLevel(arg)) {
+            options.OptLevel = *level;
+        } else if (arg == "-lazy") {
+            options.LazyCompilation = true;
+        } else if (arg == "-redefine") {
+            options.AllowRedefinition = true;
+        } else if (arg.rfind(kEmitObjFlag, 0) == 0) {
+            aot_outputs.Object = arg.substr(kEmitObjFlag.size());
+        } else if (arg.rfind(kEmitLibFlag, 0) == 0) {
+            aot_outputs.Archive = arg.substr(kEmitLibFlag.size());
+        } else if (arg.rfind(kEmitHeaderFlag, 0) == 0) {
+            aot_outputs.Header = arg.substr(kEmitHeaderFlag.size());
+        } else if (arg == "-host-cpu") {
+            aot_host_cpu = true;
+        } else if (arg == "-syntax-only") {
+            syntax_only = true;
+        } else if (arg.rfind(kCacheDirFlag, 0) == 0) {
+            options.ObjectCacheDirectory = arg.substr(kCacheDirFlag.size());
+        } else if (arg.rfind(kCompileThreadsFlag, 0) == 0) {
+            if (!ParseUnsigned(arg.substr(kCompileThreadsFlag.size()),
+                               &options.CompileThreads)) {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+        } else if (arg.rfind(kParseThreadsFlag, 0) == 0) {
+            if (!ParseUnsigned(arg.substr(kParseThreadsFlag.size()),
+                               &parse_threads)) {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+        } else if (arg.rfind(kTierUpFlag, 0) == 0) {
+            if (!ParseUnsigned(arg.substr(kTierUpFlag.size()),
+                               &options.TierUpThreshold)) {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+        } else if (arg.rfind(kInlineThresholdFlag, 0) == 0) {
+            unsigned inline_threshold = 0;
+            if (!ParseUnsigned(arg.substr(kInlineThresholdFlag.size()),
+                               &inline_threshold)) {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+            options.InlineThreshold = inline_threshold;
+        } else if (arg.rfind(kMemoizeFlag, 0) == 0) {
+            for (std::string_view name :
+                 SplitList(arg.substr(kMemoizeFlag.size()))) {
+                options.MemoizedFunctions.emplace_back(name);
+            }
+        } else if (arg.rfind(kFastMathFlag, 0) == 0) {
+            if (!ParseFastMathFlags(arg.substr(kFastMathFlag.size()),
+                                    &options.FastMath)) {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+        } else if (arg.rfind(kTimeTraceFlag, 0) == 0 &&
+                   arg.size() > kTimeTraceFlag.size()) {
+            time_trace_file = arg.substr(kTimeTraceFlag.size());
+        } else if (arg.rfind(kTimeTraceGranularityFlag, 0) == 0) {
+            if (!ParseUnsigned(arg.substr(kTimeTraceGranularityFlag.size()),
+                               &time_trace_granularity_us)) {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+        } else if (!arg.empty() && !batch_file &&
+                   (arg == "-" || arg.front() != '-')) {
+            batch_file = arg;
+        } else {
+            PrintUsage(argv[0]);
+            return 1;
         }
     }
 
-    return 0;
-}
\ No newline at end of file
+    if (syntax_only) {
+        if (!batch_file) {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+        return RunSyntaxCheck(*batch_file, parse_threads);
+    }
+
+    if (aot_outputs.Any()) {
+        if (!batch_file) {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+#ifdef KALEIDOSCOPE_BACKEND_VM
+        std::cerr << "Ahead-of-time compilation needs the LLVM backend\n";
+        return 1;
+#else
+        if (time_trace_file) time_trace::Begin(time_trace_granularity_us);
+        AotOptions aot_options;
+        aot_options.OptLevel = options.OptLevel;
+        aot_options.TuneForHost = aot_host_cpu;
+        aot_options.FastMath = options.FastMath;
+        int exit_code =
+            RunAot(aot_options, aot_outputs, *batch_file, parse_threads);
+        if (time_trace_file && !time_trace::Finish(*time_trace_file)) {
+            exit_code = 1;
+        }
+        return exit_code;
+#endif
+    }
+
+    if (time_trace_file) time_trace::Begin(time_trace_granularity_us);
+#ifdef KALEIDOSCOPE_BACKEND_VM
+    // Bytecode never refers to the AST, and none of the JIT options apply.
+    Interpreter interpreter;
+#else
+    Interpreter interpreter(options);
+#endif
+
+    int exit_code = 0;
+    if (batch_file) {
+        exit_code = RunBatch(interpreter, *batch_file, parse_threads);
+    } else {
+        RunInteractive(interpreter);
+    }
+
+#ifndef KALEIDOSCOPE_BACKEND_VM
+    if (!options.ObjectCacheDirectory.empty()) {
+        const ObjectCacheStats stats = interpreter.GetObjectCacheStats();
+        std::cerr << "Object cache: " << stats.Hits << " hits, "
+                  << stats.Misses << " misses\n";
+    }
+    for (const std::string& name : options.MemoizedFunctions) {
+        if (const auto stats = interpreter.GetMemoStats(name)) {
+            std::cerr << "Memoized " << name << ": " << stats->Hits
+                      << " hits, " << stats->Misses << " misses\n";
+        }
+    }
+#endif
+
+    if (time_trace_file && !time_trace::Finish(*time_trace_file)) {
+        exit_code = 1;
+    }
+
+    return exit_code;
+}
@@ -0,0 +1,139 @@
+#include "kaleidoscope/ast/arena.h"
+#include "kaleidoscope/ast/base_expression.h"
+#include "kaleidoscope/ast/binary_op.h"
+#include "kaleidoscope/ast/fn_call.h"
+#include "kaleidoscope/ast/fn_prototype.h"
+#include "kaleidoscope/ast/number.h"
+#include "kaleidoscope/ast/variable.h"
+#include "kaleidoscope/ir_generator.h"
+#include "kaleidoscope/symbol_table.h"
+
+#include <benchmark/benchmark.h>
+#include <llvm/IR/DataLayout.h>
+
+#include <vector>
+
+using kaleidoscope::FunctionArities;
+using kaleidoscope::IRGenerator;
+using kaleidoscope::Symbol;
+using kaleidoscope::SymbolTable;
+using kaleidoscope::ast::Arena;
+using kaleidoscope::ast::BaseExpression;
+using kaleidoscope::ast::BinaryOp;
+using kaleidoscope::ast::cast;
+using kaleidoscope::ast::ExpressionKind;
+using kaleidoscope::ast::FnCall;
+using kaleidoscope::ast::FnPrototype;
+using kaleidoscope::ast::Number;
+using kaleidoscope::ast::Variable;
+
+namespace
+{
+// A tree `depth` binary operations deep, every level mixing in a variable,
+// a number and a call: ((x + 1) * g(x)) - ...
+const BaseExpression* BuildDeepTree(Arena* arena, SymbolTable* symbols,
+                                    size_t depth)
+{
+    const Symbol x = symbols->Intern("x");
+    const BaseExpression* tree = arena->New<Variable>(x);
+    for (size_t level = 0; level < depth; ++level) {
+        const BaseExpression* leaf;
+        if (level % 3 == 0) {
+            leaf = arena->New<Number>(static_cast<double>(level));
+        } else if (level % 3 == 1) {
+            leaf = arena->New<Variable>(x);
+        } else {
+            const std::vector<const BaseExpression*> args = {
+                arena->New<Variable>(x)};
+            leaf = arena->New<FnCall>(symbols->Intern("g"),
+                                      arena->CopyArray(args));
+        }
+        tree = arena->New<BinaryOp>("+-*"[level % 3], tree, leaf);
+    }
+    return tree;
+}
+
+size_t CountNodesWithKind(const BaseExpression* expression)
+{
+    switch (expression->GetKind()) {
+        case ExpressionKind::kBinaryOp: {
+            const auto* bin_op = cast<BinaryOp>(expression);
+            return 1 + CountNodesWithKind(bin_op->LhsOp) +
+                   CountNodesWithKind(bin_op->RhsOp);
+        }
+        case ExpressionKind::kFnCall: {
+            size_t count = 1;
+            for (const BaseExpression* arg : cast<FnCall>(expression)->Args) {
+                count += CountNodesWithKind(arg);
+            }
+            return count;
+        }
+        default:
+            return 1;
+    }
+}
+
+// How every pass dispatched before nodes carried their kind.
+size_t CountNodesWithDynamicCast(const BaseExpression* expression)
+{
+    if (dynamic_cast<const Number*>(expression)) return 1;
+    if (dynamic_cast<const Variable*>(expression)) return 1;
+    if (const auto* bin_op = dynamic_cast<const BinaryOp*>(expression)) {
+        return 1 + CountNodesWithDynamicCast(bin_op->LhsOp) +
+               CountNodesWithDynamicCast(bin_op->RhsOp);
+    }
+    if (const auto* fn_call = dynamic_cast<const FnCall*>(expression)) {
+        size_t count = 1;
+        for (const BaseExpression* arg : fn_call->Args) {
+            count += CountNodesWithDynamicCast(arg);
+        }
+        return count;
+    }
+    return 1;
+}
+
+template <size_t (*CountNodes)(const BaseExpression*)>
+void BM_WalkDeepTree(benchmark::State& state)
+{
+    Arena arena;
+    SymbolTable symbols;
+    const BaseExpression* tree =
+        BuildDeepTree(&arena, &symbols, static_cast<size_t>(state.range(0)));
+    size_t nodes = 0;
+    for (auto _ : state) {
+        nodes = CountNodes(tree);
+        benchmark::DoNotOptimize(nodes);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * nodes));
+}
+BENCHMARK_TEMPLATE(BM_WalkDeepTree, CountNodesWithKind)
+    ->RangeMultiplier(8)
+    ->Range(8, 4096);
+BENCHMARK_TEMPLATE(BM_WalkDeepTree, CountNodesWithDynamicCast)
+    ->RangeMultiplier(8)
+    ->Range(8, 4096);
+
+void BM_GenerateIRDeepTree(benchmark::State& state)
+{
+    Arena arena;
+    SymbolTable symbols;
+    const BaseExpression* tree =
+        BuildDeepTree(&arena, &symbols, static_cast<size_t>(state.range(0)));
+    const std::vector<Symbol> args = {symbols.Intern("x")};
+    const FnPrototype proto(symbols.Intern("f"), arena.CopyArray(args));
+
+    const llvm::DataLayout data_layout("");
+    FunctionArities known_functions;
+    known_functions.Set(symbols.Intern("g"), 1);
+    IRGenerator generator(data_layout, known_functions);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(generator.GenerateFunction(&proto, tree));
+        state.PauseTiming();
+        generator.TakeModule("bench");
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(
+        static_cast<int64_t>(state.iterations() * CountNodesWithKind(tree)));
+}
+BENCHMARK(BM_GenerateIRDeepTree)->RangeMultiplier(8)->Range(8, 4096);
+}  // namespace
@@ -0,0 +1,110 @@
+#include "kaleidoscope/ast/arena.h"
+#include "kaleidoscope/ast/base_expression.h"
+#include "kaleidoscope/ast/compilation_unit.h"
+#include "kaleidoscope/ast/fn.h"
+#include "kaleidoscope/ast/fn_prototype.h"
+#include "kaleidoscope/ir_generator.h"
+#include "kaleidoscope/lexer_impl.h"
+#include "kaleidoscope/parser.h"
+#include "kaleidoscope/simplifier.h"
+#include "kaleidoscope/symbol_table.h"
+#include "synthetic_source.h"
+
+#include <benchmark/benchmark.h>
+#include <llvm/IR/DataLayout.h>
+#include <llvm/IR/Function.h>
+
+#include <fmt/core.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using kaleidoscope::FunctionArities;
+using kaleidoscope::IRGenerator;
+using kaleidoscope::LexerImpl;
+using kaleidoscope::SymbolTable;
+using kaleidoscope::ast::Arena;
+using kaleidoscope::ast::BaseExpression;
+using kaleidoscope::ast::dyn_cast;
+using kaleidoscope::ast::Fn;
+using kaleidoscope::bench::GenerateSource;
+using kaleidoscope::parser::ParseCompilationUnit;
+using kaleidoscope::simplifier::SimplifyExpression;
+
+namespace
+{
+// Arguments: number of definitions, expression depth.
+void BM_GenerateIR(benchmark::State& state)
+{
+    SymbolTable symbols;
+    LexerImpl lexer{GenerateSource(static_cast<size_t>(state.range(0)),
+                                   static_cast<size_t>(state.range(1)))};
+    const auto unit = ParseCompilationUnit(&lexer, &symbols);
+
+    std::vector<const Fn*> definitions;
+    FunctionArities known_functions;
+    for (const auto* item : unit.Items) {
+        if (const auto* fn = dyn_cast<Fn>(item)) {
+            definitions.push_back(fn);
+            known_functions.Set(fn->Proto->Name, fn->Proto->Args.size());
+        }
+    }
+
+    const llvm::DataLayout data_layout("");
+    IRGenerator generator(data_layout, known_functions);
+    // The module is the same every time, count its instructions once.
+    double instructions = 0;
+    for (const Fn* fn : definitions) {
+        const llvm::Function* function =
+            generator.GenerateFunction(fn->Proto, fn->Body);
+        instructions += function->getInstructionCount();
+    }
+    generator.TakeModule("bench");
+
+    for (auto _ : state) {
+        for (const Fn* fn : definitions) {
+            benchmark::DoNotOptimize(
+                generator.GenerateFunction(fn->Proto, fn->Body));
+        }
+        state.PauseTiming();
+        generator.TakeModule("bench");
+        state.ResumeTiming();
+    }
+    state.counters["instructions/s"] = benchmark::Counter(
+        instructions * static_cast<double>(state.iterations()),
+        benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_GenerateIR)->ArgsProduct({{16, 256}, {4, 64}});
+
+// Arguments: number of literals summed up in the body, whether the body is
+// simplified before lowering it. Simplifying is part of the measured time.
+void BM_GenerateIRForLiteralChain(benchmark::State& state)
+{
+    std::string source = "def c(x) x * (0";
+    for (int64_t i = 1; i < state.range(0); ++i) {
+        source += fmt::format(" + {}", i);
+    }
+    source += ")";
+
+    SymbolTable symbols;
+    LexerImpl lexer{std::move(source)};
+    const auto unit = ParseCompilationUnit(&lexer, &symbols);
+    const auto* fn = dyn_cast<Fn>(unit.Items.front());
+
+    const llvm::DataLayout data_layout("");
+    const FunctionArities known_functions;
+    IRGenerator generator(data_layout, known_functions);
+    const bool simplify = state.range(1) != 0;
+    for (auto _ : state) {
+        Arena arena;
+        const BaseExpression* body =
+            simplify ? SimplifyExpression(fn->Body, &arena) : fn->Body;
+        benchmark::DoNotOptimize(generator.GenerateFunction(fn->Proto, body));
+        state.PauseTiming();
+        generator.TakeModule("bench");
+        state.ResumeTiming();
+    }
+}
+BENCHMARK(BM_GenerateIRForLiteralChain)->ArgsProduct({{64, 4096}, {0, 1}});
+}  // namespace
@@ -0,0 +1,263 @@
+#include "kaleidoscope/ast/arena.h"
+#include "kaleidoscope/jit_interpreter.h"
+#include "kaleidoscope/jit_options.h"
+#include "kaleidoscope/lexer_impl.h"
+#include "kaleidoscope/parser.h"
+#include "synthetic_source.h"
+
+#include <benchmark/benchmark.h>
+#include <fmt/core.h>
+
+#include <string>
+#include <vector>
+
+using kaleidoscope::JitInterpreter;
+using kaleidoscope::JitOptions;
+using kaleidoscope::LexerImpl;
+using kaleidoscope::OptimizationLevel;
+using kaleidoscope::ast::Arena;
+using kaleidoscope::bench::GenerateSource;
+using kaleidoscope::parser::ParseCompilationUnit;
+using kaleidoscope::parser::ParseNextExpression;
+
+namespace
+{
+// Time from source text to result for one top-level expression typed into a
+// session that already holds the definitions: lex, parse, lower, compile
+// and run. Arguments: optimization level.
+void BM_EvaluateExpressionLatency(benchmark::State& state)
+{
+    JitOptions options;
+    options.OptLevel = static_cast<OptimizationLevel>(state.range(0));
+    JitInterpreter interpreter(options);
+
+    LexerImpl definitions_lexer{GenerateSource(16, 16)};
+    const auto unit = ParseCompilationUnit(&definitions_lexer,
+                                           &interpreter.GetSymbolTable());
+    interpreter.EvaluateUnit(unit);
+
+    const std::string input = "f15(1, 2) + f7(3, 4) * 2";
+    for (auto _ : state) {
+        LexerImpl lexer{std::string(input)};
+        Arena arena;
+        const auto* expression =
+            ParseNextExpression(&lexer, &arena, &interpreter.GetSymbolTable());
+        benchmark::DoNotOptimize(interpreter.EvaluateExpression(expression));
+    }
+    state.SetLabel(OptimizationLevelToString(options.OptLevel));
+}
+BENCHMARK(BM_EvaluateExpressionLatency)
+    ->DenseRange(static_cast<int>(OptimizationLevel::kO0),
+                 static_cast<int>(OptimizationLevel::kO3))
+    ->Unit(benchmark::kMicrosecond);
+
+// One call through a native handle to the same function as above, which
+// skips everything but running it. Arguments: optimization level.
+void BM_CallFunctionHandle(benchmark::State& state)
+{
+    JitOptions options;
+    options.OptLevel = static_cast<OptimizationLevel>(state.range(0));
+    JitInterpreter interpreter(options);
+    interpreter.EvaluateSource(GenerateSource(16, 16));
+
+    auto* f15 = interpreter.GetFunction<double(double, double)>("f15");
+    if (!f15) {
+        state.SkipWithError("f15 did not compile");
+        return;
+    }
+    double x = 1;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(x);
+        benchmark::DoNotOptimize(f15(x, 2));
+    }
+    state.SetLabel(OptimizationLevelToString(options.OptLevel));
+}
+BENCHMARK(BM_CallFunctionHandle)
+    ->Arg(static_cast<int>(OptimizationLevel::kO0))
+    ->Arg(static_cast<int>(OptimizationLevel::kO2));
+
+// Same as BM_EvaluateExpressionLatency in a tiered session, where the
+// expression is interpreted and the definitions it calls are compiled once
+// they ran `threshold` times. Arguments: threshold.
+void BM_EvaluateTieredExpressionLatency(benchmark::State& state)
+{
+    JitOptions options;
+    options.TierUpThreshold = static_cast<unsigned>(state.range(0));
+    JitInterpreter interpreter(options);
+
+    // Tiered definitions are lowered when called, keep their ASTs alive.
+    LexerImpl definitions_lexer{GenerateSource(16, 16)};
+    const auto unit = ParseCompilationUnit(&definitions_lexer,
+                                           &interpreter.GetSymbolTable());
+    interpreter.EvaluateUnit(unit);
+
+    const std::string input = "f15(1, 2) + f7(3, 4) * 2";
+    for (auto _ : state) {
+        LexerImpl lexer{std::string(input)};
+        Arena arena;
+        const auto* expression =
+            ParseNextExpression(&lexer, &arena, &interpreter.GetSymbolTable());
+        benchmark::DoNotOptimize(interpreter.EvaluateExpression(expression));
+    }
+}
+BENCHMARK(BM_EvaluateTieredExpressionLatency)
+    ->Arg(1)
+    ->Arg(1 << 30)
+    ->Unit(benchmark::kMicrosecond);
+
+// A whole batch file through a fresh session. Arguments: number of
+// definitions, expression depth, compile threads.
+void BM_EvaluateUnit(benchmark::State& state)
+{
+    const std::string source =
+        GenerateSource(static_cast<size_t>(state.range(0)),
+                       static_cast<size_t>(state.range(1)));
+    JitOptions options;
+    options.CompileThreads = static_cast<unsigned>(state.range(2));
+    for (auto _ : state) {
+        JitInterpreter interpreter(options);
+        LexerImpl lexer{std::string(source)};
+        const auto unit =
+            ParseCompilationUnit(&lexer, &interpreter.GetSymbolTable());
+        benchmark::DoNotOptimize(interpreter.EvaluateUnit(unit));
+    }
+}
+BENCHMARK(BM_EvaluateUnit)
+    ->ArgsProduct({{16, 256}, {4, 64}, {0, 4}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// Rows per second through EvaluateBatch, for a formula split over a few
+// small definitions. The loop is compiled before timing starts. Arguments:
+// number of rows, fast-math.
+void BM_EvaluateBatch(benchmark::State& state)
+{
+    JitOptions options;
+    if (state.range(1)) {
+        options.FastMath.Contract = true;
+        options.FastMath.Reassoc = true;
+    }
+    JitInterpreter interpreter(options);
+    LexerImpl lexer{std::string(
+        "def sq(x) x * x "
+        "def lerp(a b t) a + (b - a) * t "
+        "def f(x y) lerp(sq(x), y * 3, 4) - x")};
+    interpreter.EvaluateUnit(
+        ParseCompilationUnit(&lexer, &interpreter.GetSymbolTable()));
+
+    const size_t rows = static_cast<size_t>(state.range(0));
+    std::vector<double> x(rows);
+    std::vector<double> y(rows);
+    for (size_t row = 0; row < rows; ++row) {
+        x[row] = static_cast<double>(row) * 0.5;
+        y[row] = static_cast<double>(rows - row);
+    }
+    std::vector<double> out(rows);
+    if (!interpreter.EvaluateBatch("f", {x.data(), y.data()}, 0, nullptr)) {
+        state.SkipWithError("Could not compile the batch");
+        return;
+    }
+    for (auto _ : state) {
+        interpreter.EvaluateBatch("f", {x.data(), y.data()}, rows,
+                                  out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * rows));
+}
+BENCHMARK(BM_EvaluateBatch)->ArgsProduct({{1 << 10, 1 << 20}, {0, 1}});
+
+// A call tree where each level calls the one below twice with overlapping
+// arguments, 2^20 leaves unless the levels are memoized. Arguments:
+// memoize.
+void BM_EvaluateCallTree(benchmark::State& state)
+{
+    constexpr int kDepth = 20;
+    std::string source = "def t0(x) x * x ";
+    JitOptions options;
+    for (int level = 1; level <= kDepth; ++level) {
+        source += fmt::format("def t{0}(x) t{1}(x) + t{1}(x + 1) ", level,
+                              level - 1);
+    }
+    if (state.range(0)) {
+        for (int level = 0; level <= kDepth; ++level) {
+            options.MemoizedFunctions.push_back(fmt::format("t{}", level));
+        }
+    }
+    JitInterpreter interpreter(options);
+    LexerImpl definitions_lexer{std::move(source)};
+    interpreter.EvaluateUnit(ParseCompilationUnit(
+        &definitions_lexer, &interpreter.GetSymbolTable()));
+
+    const std::string input = fmt::format("t{}(1)", kDepth);
+    for (auto _ : state) {
+        LexerImpl lexer{std::string(input)};
+        Arena arena;
+        const auto* expression =
+            ParseNextExpression(&lexer, &arena, &interpreter.GetSymbolTable());
+        benchmark::DoNotOptimize(interpreter.EvaluateExpression(expression));
+    }
+}
+BENCHMARK(BM_EvaluateCallTree)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// Calls a function built from small helpers, each typed in as an item of
+// its own, so that they land in separate modules. Arguments: inline
+// threshold.
+void BM_CallSmallHelpers(benchmark::State& state)
+{
+    JitOptions options;
+    options.OptLevel = OptimizationLevel::kO2;
+    options.InlineThreshold = static_cast<size_t>(state.range(0));
+    JitInterpreter interpreter(options);
+    for (const char* input :
+         {"def sq(x) x * x", "def lerp(a b t) a + (b - a) * t",
+          "def step(x y) lerp(x, y, sq(x))",
+          "def walk(x y) step(step(step(x, y), y), y)"}) {
+        LexerImpl lexer{std::string(input)};
+        Arena arena;
+        interpreter.EvaluateExpression(
+            ParseNextExpression(&lexer, &arena, &interpreter.GetSymbolTable()));
+    }
+
+    auto* walk = interpreter.GetFunction<double(double, double)>("walk");
+    if (!walk) {
+        state.SkipWithError("walk did not compile");
+        return;
+    }
+    double x = 0.5;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(x);
+        benchmark::DoNotOptimize(walk(x, 0.25));
+    }
+}
+BENCHMARK(BM_CallSmallHelpers)->Arg(0)->Arg(32);
+
+// Replaces the body of one function called by most of a session of 256
+// definitions. Compare with BM_EvaluateUnit, the cost of starting the
+// session over. Arguments: optimization level.
+void BM_RedefineFunction(benchmark::State& state)
+{
+    JitOptions options;
+    options.OptLevel = static_cast<OptimizationLevel>(state.range(0));
+    options.AllowRedefinition = true;
+    JitInterpreter interpreter(options);
+    LexerImpl definitions_lexer{GenerateSource(256, 4)};
+    interpreter.EvaluateUnit(ParseCompilationUnit(
+        &definitions_lexer, &interpreter.GetSymbolTable()));
+
+    int version = 0;
+    for (auto _ : state) {
+        const std::string input =
+            fmt::format("def f0(x y) x * y + {}", ++version);
+        LexerImpl lexer{std::string(input)};
+        Arena arena;
+        const auto* definition =
+            ParseNextExpression(&lexer, &arena, &interpreter.GetSymbolTable());
+        interpreter.EvaluateExpression(definition);
+    }
+    state.SetLabel(OptimizationLevelToString(options.OptLevel));
+}
+BENCHMARK(BM_RedefineFunction)
+    ->Arg(static_cast<int>(OptimizationLevel::kO0))
+    ->Arg(static_cast<int>(OptimizationLevel::kO2))
+    ->Unit(benchmark::kMicrosecond);
+}  // namespace
@@ -0,0 +1,39 @@
+#include "kaleidoscope/lexer_impl.h"
+#include "kaleidoscope/token.h"
+#include "synthetic_source.h"
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+
+using kaleidoscope::LexerImpl;
+using kaleidoscope::TokenType;
+using kaleidoscope::bench::GenerateSource;
+
+namespace
+{
+// Arguments: number of definitions, expression depth.
+void BM_LexTokens(benchmark::State& state)
+{
+    const std::string source =
+        GenerateSource(static_cast<size_t>(state.range(0)),
+                       static_cast<size_t>(state.range(1)));
+    int64_t tokens = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        LexerImpl lexer{std::string(source)};
+        state.ResumeTiming();
+
+        while (true) {
+            const auto token = lexer.PeekToken();
+            if (!token || token->Type == TokenType::kEof) break;
+            lexer.ConsumeToken();
+            ++tokens;
+        }
+    }
+    state.SetItemsProcessed(tokens);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() *
+                                                 source.size()));
+}
+BENCHMARK(BM_LexTokens)->ArgsProduct({{16, 256, 4096}, {4, 64}});
+}  // namespace
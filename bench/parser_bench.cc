@@ -0,0 +1,72 @@
+#include "kaleidoscope/ast/arena.h"
+#include "kaleidoscope/lexer_impl.h"
+#include "kaleidoscope/parser.h"
+#include "kaleidoscope/symbol_table.h"
+#include "synthetic_source.h"
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+
+using kaleidoscope::LexerImpl;
+using kaleidoscope::SymbolTable;
+using kaleidoscope::ast::Arena;
+using kaleidoscope::bench::CountNodes;
+using kaleidoscope::bench::GenerateSource;
+using kaleidoscope::parser::ParseCompilationUnitInParallel;
+using kaleidoscope::parser::ParseNextExpression;
+
+namespace
+{
+// Arguments: number of definitions, expression depth.
+void BM_ParseItems(benchmark::State& state)
+{
+    const std::string source =
+        GenerateSource(static_cast<size_t>(state.range(0)),
+                       static_cast<size_t>(state.range(1)));
+    SymbolTable symbols;
+    size_t nodes = 0;
+    {
+        LexerImpl lexer{std::string(source)};
+        Arena arena;
+        while (const auto* item =
+                   ParseNextExpression(&lexer, &arena, &symbols)) {
+            nodes += CountNodes(item);
+        }
+    }
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        LexerImpl lexer{std::string(source)};
+        state.ResumeTiming();
+
+        Arena arena;
+        while (ParseNextExpression(&lexer, &arena, &symbols)) {
+        }
+    }
+    state.counters["nodes/s"] = benchmark::Counter(
+        static_cast<double>(nodes) * static_cast<double>(state.iterations()),
+        benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_ParseItems)->ArgsProduct({{16, 256, 4096}, {4, 64}});
+
+// Arguments: number of definitions, expression depth, threads.
+void BM_ParseItemsInParallel(benchmark::State& state)
+{
+    const std::string source =
+        GenerateSource(static_cast<size_t>(state.range(0)),
+                       static_cast<size_t>(state.range(1)));
+    const auto threads = static_cast<unsigned>(state.range(2));
+    SymbolTable symbols;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+            ParseCompilationUnitInParallel(source, &symbols, threads));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() *
+                                                 source.size()));
+}
+BENCHMARK(BM_ParseItemsInParallel)
+    ->ArgsProduct({{4096, 65536}, {4}, {1, 2, 4, 8}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+}  // namespace
@@ -0,0 +1,66 @@
+#include "synthetic_source.h"
+
+#include "kaleidoscope/ast/binary_op.h"
+#include "kaleidoscope/ast/fn.h"
+#include "kaleidoscope/ast/fn_call.h"
+
+#include <fmt/core.h>
+
+namespace kaleidoscope::bench
+{
+namespace
+{
+void AppendBody(std::string& source, size_t definition, size_t depth)
+{
+    // Innermost operand first, then wrap it `depth` times.
+    std::string body =
+        definition == 0 ? "a" : fmt::format("f{}(a, b)", definition - 1);
+    for (size_t level = 0; level < depth; ++level) {
+        const char op = "+-*"[level % 3];
+        const std::string operand =
+            level % 2 == 0 ? "b" : fmt::format("{}", level);
+        body = fmt::format("({} {} {})", body, op, operand);
+    }
+    source += body;
+}
+}  // namespace
+
+std::string GenerateSource(size_t definitions, size_t depth)
+{
+    std::string source;
+    for (size_t i = 0; i < definitions; ++i) {
+        source += fmt::format("def f{}(a b) ", i);
+        AppendBody(source, i, depth);
+        source += fmt::format("\nf{}({}, 2)\n", i, i);
+    }
+    return source;
+}
+
+size_t CountNodes(const ast::BaseExpression* expression)
+{
+    switch (expression->GetKind()) {
+        case ast::ExpressionKind::kBinaryOp: {
+            const auto* bin_op = ast::cast<ast::BinaryOp>(expression);
+            return 1 + CountNodes(bin_op->LhsOp) + CountNodes(bin_op->RhsOp);
+        }
+        case ast::ExpressionKind::kFnCall: {
+            size_t count = 1;
+            for (const ast::BaseExpression* arg :
+                 ast::cast<ast::FnCall>(expression)->Args) {
+                count += CountNodes(arg);
+            }
+            return count;
+        }
+        case ast::ExpressionKind::kFn: {
+            const auto* definition = ast::cast<ast::Fn>(expression);
+            return 1 + CountNodes(definition->Proto) +
+                   CountNodes(definition->Body);
+        }
+        case ast::ExpressionKind::kNumber:
+        case ast::ExpressionKind::kVariable:
+        case ast::ExpressionKind::kFnPrototype:
+            break;
+    }
+    return 1;
+}
+}  // namespace kaleidoscope::bench
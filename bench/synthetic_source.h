@@ -0,0 +1,21 @@
+#ifndef KALEIDOSCOPE_BENCH_SYNTHETIC_SOURCE_H
+#define KALEIDOSCOPE_BENCH_SYNTHETIC_SOURCE_H
+
+#include "kaleidoscope/ast/base_expression.h"
+
+#include <cstddef>
+#include <string>
+
+namespace kaleidoscope::bench
+{
+// Kaleidoscope source with `definitions` functions f0, f1, ... of two
+// arguments, each followed by a top-level call to it. Every body nests
+// `depth` parenthesized binary operations, mixing numbers, arguments and
+// one call to the previous function.
+std::string GenerateSource(size_t definitions, size_t depth);
+
+// Number of nodes of the tree rooted at `expression`, prototypes included.
+size_t CountNodes(const ast::BaseExpression* expression);
+}  // namespace kaleidoscope::bench
+
+#endif  // KALEIDOSCOPE_BENCH_SYNTHETIC_SOURCE_H
@@ -0,0 +1,57 @@
+#include "kaleidoscope/ast/arena.h"
+#include "kaleidoscope/lexer_impl.h"
+#include "kaleidoscope/parser.h"
+#include "kaleidoscope/vm_interpreter.h"
+#include "synthetic_source.h"
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+
+using kaleidoscope::LexerImpl;
+using kaleidoscope::VmInterpreter;
+using kaleidoscope::ast::Arena;
+using kaleidoscope::bench::GenerateSource;
+using kaleidoscope::parser::ParseCompilationUnit;
+using kaleidoscope::parser::ParseNextExpression;
+
+namespace
+{
+// Bytecode counterpart of BM_EvaluateExpressionLatency.
+void BM_VmEvaluateExpressionLatency(benchmark::State& state)
+{
+    VmInterpreter interpreter;
+    LexerImpl definitions_lexer{GenerateSource(16, 16)};
+    interpreter.EvaluateUnit(ParseCompilationUnit(
+        &definitions_lexer, &interpreter.GetSymbolTable()));
+
+    const std::string input = "f15(1, 2) + f7(3, 4) * 2";
+    for (auto _ : state) {
+        LexerImpl lexer{std::string(input)};
+        Arena arena;
+        const auto* expression =
+            ParseNextExpression(&lexer, &arena, &interpreter.GetSymbolTable());
+        benchmark::DoNotOptimize(interpreter.EvaluateExpression(expression));
+    }
+}
+BENCHMARK(BM_VmEvaluateExpressionLatency)->Unit(benchmark::kMicrosecond);
+
+// Bytecode counterpart of BM_EvaluateUnit. Arguments: number of
+// definitions, expression depth.
+void BM_VmEvaluateUnit(benchmark::State& state)
+{
+    const std::string source =
+        GenerateSource(static_cast<size_t>(state.range(0)),
+                       static_cast<size_t>(state.range(1)));
+    for (auto _ : state) {
+        VmInterpreter interpreter;
+        LexerImpl lexer{std::string(source)};
+        const auto unit =
+            ParseCompilationUnit(&lexer, &interpreter.GetSymbolTable());
+        benchmark::DoNotOptimize(interpreter.EvaluateUnit(unit));
+    }
+}
+BENCHMARK(BM_VmEvaluateUnit)
+    ->ArgsProduct({{16, 256}, {4, 64}})
+    ->Unit(benchmark::kMillisecond);
+}  // namespace
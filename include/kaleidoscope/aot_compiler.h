@@ -0,0 +1,86 @@
+#ifndef KALEIDOSCOPE_AOT_COMPILER_H
+#define KALEIDOSCOPE_AOT_COMPILER_H
+
+#include "kaleidoscope/ir_generator.h"
+#include "kaleidoscope/jit_options.h"
+#include "kaleidoscope/symbol_table.h"
+
+#include <llvm/IR/DataLayout.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace kaleidoscope
+{
+
+namespace ast
+{
+struct CompilationUnit;
+}  // namespace ast
+
+struct AotOptions {
+    OptimizationLevel OptLevel = OptimizationLevel::kO2;
+
+    // Generate code for the CPU of this machine, using every extension it
+    // has. By default the code runs on any CPU of the host architecture.
+    bool TuneForHost = false;
+
+    // Fast-math flags of every definition.
+    FastMathFlags FastMath;
+};
+
+// Compiles definitions ahead of time, for programs that link them instead
+// of running a JIT. Every definition becomes an external function
+// `double name(double...)` with the C calling convention, and externs are
+// left for the linker to resolve.
+class AotCompiler
+{
+   public:
+    AotCompiler();
+    explicit AotCompiler(AotOptions options);
+    AotCompiler(const AotCompiler& t) = delete;
+    AotCompiler& operator=(const AotCompiler&) = delete;
+    ~AotCompiler();
+
+    // Lowers the definitions of the unit into the library, they can call
+    // the externs and definitions of any unit added so far. Top-level
+    // expressions have nowhere to run and are rejected. Returns false if
+    // any item fails, the definitions that failed, along with their
+    // callers, are left out of the library.
+    bool AddUnit(const ast::CompilationUnit& unit);
+
+    // Optimizes and compiles the library into a relocatable, position
+    // independent object. No units can be added afterwards.
+    bool WriteObject(const std::string& path);
+
+    // Same object, as the only member of a static library.
+    bool WriteArchive(const std::string& path);
+
+    // C and C++ header declaring every definition of the library.
+    bool WriteHeader(const std::string& path) const;
+
+    // Identifiers of every AST given to the compiler must be interned in
+    // this table.
+    SymbolTable& GetSymbolTable();
+
+   private:
+    const llvm::MemoryBuffer* Compile();
+
+   private:
+    AotOptions options_;
+    SymbolTable symbols_;
+    std::unique_ptr<llvm::TargetMachine> target_machine_ = nullptr;
+    llvm::DataLayout data_layout_;
+    FunctionArities function_arities_;
+    FastMathPolicy fast_math_;
+    std::unique_ptr<IRGenerator> generator_ = nullptr;
+    // Definitions of the library, in source order.
+    std::vector<Symbol> definitions_;
+    std::unique_ptr<llvm::MemoryBuffer> object_ = nullptr;
+};
+}  // namespace kaleidoscope
+
+#endif  // KALEIDOSCOPE_AOT_COMPILER_H
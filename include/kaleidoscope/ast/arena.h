@@ -0,0 +1,85 @@
+#ifndef KALEIDOSCOPE_AST_ARENA_H
+#define KALEIDOSCOPE_AST_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace kaleidoscope::ast
+{
+// Non-owning view over an array allocated in an Arena.
+template <typename T>
+class Span
+{
+   public:
+    Span() = default;
+    Span(T* data, size_t size) : data_(data), size_(size) {}
+
+    T* begin() const { return data_; }
+    T* end() const { return data_ + size_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    T& operator[](size_t index) const { return data_[index]; }
+
+   private:
+    T* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Bump-pointer allocator for AST nodes. Nodes are placed one after the other
+// in large chunks and are never destroyed individually, the whole arena is
+// released at once when it goes away.
+class Arena
+{
+   public:
+    Arena();
+    ~Arena();
+    Arena(const Arena& t) = delete;
+    Arena& operator=(const Arena&) = delete;
+    Arena(Arena&& other) noexcept;
+    Arena& operator=(Arena&& other) noexcept;
+
+    template <typename T, typename... Args>
+    T* New(Args&&... args)
+    {
+        // Destructors are never run.
+        static_assert(std::is_trivially_destructible_v<T>);
+        return new (Allocate(sizeof(T), alignof(T)))
+            T(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    Span<const T> CopyArray(const std::vector<T>& elements)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (elements.empty()) return {};
+        T* data = static_cast<T*>(
+            Allocate(sizeof(T) * elements.size(), alignof(T)));
+        std::uninitialized_copy(elements.begin(), elements.end(), data);
+        return Span<const T>(data, elements.size());
+    }
+
+    // Takes over the memory of `other`, so that nodes allocated from it
+    // live as long as this arena. `other` is left empty.
+    void Adopt(Arena&& other);
+
+    // Bytes handed out so far, alignment padding included.
+    size_t BytesUsed() const;
+
+   private:
+    void* Allocate(size_t size, size_t alignment);
+
+   private:
+    std::vector<std::unique_ptr<std::byte[]>> chunks_;
+    std::byte* cursor_ = nullptr;
+    std::byte* chunk_end_ = nullptr;
+    size_t next_chunk_size_;
+    size_t bytes_used_ = 0;
+};
+
+}  // namespace kaleidoscope::ast
+
+#endif  // KALEIDOSCOPE_AST_ARENA_H
@@ -1,20 +1,61 @@
 #ifndef KALEIDOSCOPE_AST_EXPRESSION_H
 #define KALEIDOSCOPE_AST_EXPRESSION_H
 
+#include <cassert>
 #include <string>
 
 namespace kaleidoscope::ast
 {
+// Concrete type of a node, so passes can switch over it instead of probing
+// with dynamic_cast.
+enum class ExpressionKind {
+    kNumber,
+    kVariable,
+    kBinaryOp,
+    kFnCall,
+    kFnPrototype,
+    kFn,
+};
+
 class BaseExpression
 {
    public:
-    virtual ~BaseExpression() = default;
+    ExpressionKind GetKind() const { return kind_; }
 
     virtual void PrintToString(std::string& out_str, size_t indent_level = 0,
                                char space_char = ' ',
                                size_t indent_size = 2) const = 0;
+
+   protected:
+    explicit BaseExpression(ExpressionKind kind) : kind_(kind) {}
+    // Nodes live in an Arena and are never deleted through this class.
+    ~BaseExpression() = default;
+
+   private:
+    const ExpressionKind kind_;
 };
 
+// LLVM-style casts over the kind tag. Every node type declares its tag as
+// `kKind`.
+template <typename T>
+bool isa(const BaseExpression* expression)
+{
+    return expression->GetKind() == T::kKind;
+}
+
+template <typename T>
+const T* cast(const BaseExpression* expression)
+{
+    assert(isa<T>(expression) && "cast to the wrong node type");
+    return static_cast<const T*>(expression);
+}
+
+template <typename T>
+const T* dyn_cast(const BaseExpression* expression)
+{
+    return isa<T>(expression) ? static_cast<const T*>(expression) : nullptr;
+}
+
 }  // namespace kaleidoscope::ast
 
 #endif // KALEIDOSCOPE_AST_EXPRESSION_H
\ No newline at end of file
@@ -3,17 +3,18 @@
 
 #include "kaleidoscope/ast/base_expression.h"
 
-#include <memory>
 
 namespace kaleidoscope::ast
 {
 struct BinaryOp : public BaseExpression {
-    BinaryOp(char op, std::unique_ptr<BaseExpression> lhs_op,
-             std::unique_ptr<BaseExpression> rhs_op);
+    static constexpr ExpressionKind kKind = ExpressionKind::kBinaryOp;
+
+    BinaryOp(char op, const BaseExpression* lhs_op,
+             const BaseExpression* rhs_op);
 
     char Op;
-    std::unique_ptr<BaseExpression> LhsOp;
-    std::unique_ptr<BaseExpression> RhsOp;
+    const BaseExpression* LhsOp;
+    const BaseExpression* RhsOp;
 
     void PrintToString(std::string& out_str, size_t indent_level,
                        char space_char, size_t indent_size) const final;
@@ -0,0 +1,14 @@
+#ifndef KALEIDOSCOPE_AST_CLONE_H
+#define KALEIDOSCOPE_AST_CLONE_H
+
+#include "kaleidoscope/ast/arena.h"
+#include "kaleidoscope/ast/base_expression.h"
+
+namespace kaleidoscope::ast
+{
+// Deep copies `expression` into `arena`, so it outlives the arena it was
+// parsed into. Symbols are shared, the copy belongs to the same table.
+const BaseExpression* Clone(const BaseExpression* expression, Arena* arena);
+}  // namespace kaleidoscope::ast
+
+#endif  // KALEIDOSCOPE_AST_CLONE_H
@@ -0,0 +1,21 @@
+#ifndef KALEIDOSCOPE_AST_COMPILATION_UNIT_H
+#define KALEIDOSCOPE_AST_COMPILATION_UNIT_H
+
+#include "kaleidoscope/ast/arena.h"
+#include "kaleidoscope/ast/base_expression.h"
+
+#include <vector>
+
+namespace kaleidoscope::ast
+{
+// Every top-level item of a source, in source order: definitions, externs
+// and top-level expressions. The unit owns the arena all of their nodes are
+// allocated from, and frees them in one go.
+struct CompilationUnit {
+    Arena Nodes;
+    std::vector<const BaseExpression*> Items;
+};
+
+}  // namespace kaleidoscope::ast
+
+#endif // KALEIDOSCOPE_AST_COMPILATION_UNIT_H
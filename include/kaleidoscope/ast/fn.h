@@ -4,16 +4,15 @@
 #include "kaleidoscope/ast/base_expression.h"
 #include "kaleidoscope/ast/fn_prototype.h"
 
-#include <memory>
-
 namespace kaleidoscope::ast
 {
 struct Fn : public BaseExpression {
-    Fn(std::unique_ptr<FnPrototype> proto, std::unique_ptr<BaseExpression> body);
+    static constexpr ExpressionKind kKind = ExpressionKind::kFn;
+
+    Fn(const FnPrototype* proto, const BaseExpression* body);
 
-    char Op;
-    std::unique_ptr<FnPrototype> Proto;
-    std::unique_ptr<BaseExpression> Body;
+    const FnPrototype* Proto;
+    const BaseExpression* Body;
 
     void PrintToString(std::string& out_str, size_t indent_level,
                        char space_char, size_t indent_size) const final;
@@ -1,20 +1,19 @@
 #ifndef KALEIDOSCOPE_AST_FN_CALL_H
 #define KALEIDOSCOPE_AST_FN_CALL_H
 
+#include "kaleidoscope/ast/arena.h"
 #include "kaleidoscope/ast/base_expression.h"
-
-#include <memory>
-#include <string_view>
-#include <vector>
+#include "kaleidoscope/symbol_table.h"
 
 namespace kaleidoscope::ast
 {
 struct FnCall : public BaseExpression {
-    FnCall(const std::string_view& callee,
-           std::vector<std::unique_ptr<BaseExpression>> args);
+    static constexpr ExpressionKind kKind = ExpressionKind::kFnCall;
+
+    FnCall(Symbol callee, Span<const BaseExpression* const> args);
 
-    std::string_view Callee;
-    std::vector<std::unique_ptr<BaseExpression>> Args;
+    Symbol Callee;
+    Span<const BaseExpression* const> Args;
 
     void PrintToString(std::string& out_str, size_t indent_level,
                        char space_char, size_t indent_size) const final;
@@ -6,6 +6,8 @@
 namespace kaleidoscope::ast
 {
 struct Number : public BaseExpression {
+    static constexpr ExpressionKind kKind = ExpressionKind::kNumber;
+
     Number(double value);
 
     double Value;
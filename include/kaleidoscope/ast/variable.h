@@ -2,15 +2,16 @@
 #define KALEIDOSCOPE_AST_VARIABLE_H
 
 #include "kaleidoscope/ast/base_expression.h"
-
-#include <string_view>
+#include "kaleidoscope/symbol_table.h"
 
 namespace kaleidoscope::ast
 {
 struct Variable : public BaseExpression {
-    Variable(std::string_view name);
+    static constexpr ExpressionKind kKind = ExpressionKind::kVariable;
+
+    Variable(Symbol name);
 
-    std::string_view Name;
+    Symbol Name;
 
     void PrintToString(std::string& out_str, size_t indent_level,
                        char space_char, size_t indent_size) const final;
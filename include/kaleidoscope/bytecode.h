@@ -0,0 +1,66 @@
+#ifndef KALEIDOSCOPE_BYTECODE_H
+#define KALEIDOSCOPE_BYTECODE_H
+
+#include "kaleidoscope/ast/arena.h"
+#include "kaleidoscope/ast/base_expression.h"
+#include "kaleidoscope/symbol_table.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace kaleidoscope::bytecode
+{
+// R[n] is register n of the current frame, the parameters of a function
+// take its first registers. Indexes wider than a register number are split
+// across B (low half) and C (high half).
+enum class Opcode : uint8_t {
+    kLoadConstant,  // R[A] = Constants[B, C]
+    kMove,          // R[A] = R[B]
+    kAdd,           // R[A] = R[B] + R[C]
+    kSub,           // R[A] = R[B] - R[C]
+    kMul,           // R[A] = R[B] * R[C]
+    // R[A] = callee(R[A], ..., R[A + arity - 1]), where the callee is the
+    // function at index [B, C] of the session. Its frame starts at R[A], so
+    // the arguments are already in its parameter registers.
+    kCall,
+    kReturn,  // Returns R[A]
+};
+
+struct Instruction {
+    Opcode Op;
+    uint16_t A = 0;
+    uint16_t B = 0;
+    uint16_t C = 0;
+};
+static_assert(sizeof(Instruction) == 8);
+
+constexpr size_t kMaxRegisters = UINT16_MAX + 1;
+
+struct Function {
+    size_t Arity = 0;
+    // Registers a frame needs, parameters included.
+    size_t RegisterCount = 0;
+    std::vector<Instruction> Code;
+    std::vector<double> Constants;
+    // Externs have no code, calls go to the host function at this address.
+    void* HostEntry = nullptr;
+};
+
+// Index of every function of a session in its function table, keyed by
+// name.
+using FunctionIndices = SymbolMap<uint32_t>;
+
+// Compiles `body` into `out`, which must hold the arity of the function.
+// Calls are resolved against `indices` and checked against the arities in
+// `functions`. Errors are reported to standard error and return false.
+bool CompileFunction(ast::Span<const Symbol> params,
+                     const ast::BaseExpression* body,
+                     const FunctionIndices& indices,
+                     const std::vector<Function>& functions, Function* out);
+
+// Index of every function `function` calls.
+std::vector<uint32_t> GetCallees(const Function& function);
+}  // namespace kaleidoscope::bytecode
+
+#endif  // KALEIDOSCOPE_BYTECODE_H
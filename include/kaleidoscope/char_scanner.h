@@ -0,0 +1,62 @@
+#ifndef KALEIDOSCOPE_CHAR_SCANNER_H
+#define KALEIDOSCOPE_CHAR_SCANNER_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace kaleidoscope
+{
+namespace scanner
+{
+// Character classes recognized by the lexer, one bit each. They match the
+// "C" locale, whatever locale the process is using.
+enum CharClass : uint8_t {
+    kSpace = 1 << 0,
+    kAlpha = 1 << 1,
+    kDigit = 1 << 2,
+    kPunctuation = 1 << 3,
+};
+
+constexpr std::array<uint8_t, 256> BuildCharClasses()
+{
+    std::array<uint8_t, 256> classes{};
+    for (unsigned char c : {' ', '\t', '\n', '\v', '\f', '\r'}) {
+        classes[c] = kSpace;
+    }
+    for (unsigned char c = 'a'; c <= 'z'; ++c) classes[c] = kAlpha;
+    for (unsigned char c = 'A'; c <= 'Z'; ++c) classes[c] = kAlpha;
+    for (unsigned char c = '0'; c <= '9'; ++c) classes[c] = kDigit;
+    for (unsigned char c : {'(', ')', '+', '-', '*', ',', '.'}) {
+        classes[c] = kPunctuation;
+    }
+    return classes;
+}
+
+inline constexpr std::array<uint8_t, 256> kCharClasses = BuildCharClasses();
+
+constexpr bool IsInClass(unsigned char c, uint8_t char_class)
+{
+    return (kCharClasses[c] & char_class) != 0;
+}
+
+// A set of scanning kernels. Each of them returns the first character of
+// [begin, end) that is not part of the run it scans, or `end`.
+struct Kernels {
+    const char* Name;
+    const char* (*SkipWhitespace)(const char* begin, const char* end);
+    const char* (*SkipAlphaNumeric)(const char* begin, const char* end);
+    const char* (*SkipDigits)(const char* begin, const char* end);
+};
+
+const Kernels& ScalarKernels();
+
+// The widest kernels the running CPU supports, picked on the first call.
+const Kernels& SelectedKernels();
+
+// Every kernel set the running CPU supports, the scalar one included.
+std::vector<const Kernels*> SupportedKernels();
+}  // namespace scanner
+}  // namespace kaleidoscope
+
+#endif  // KALEIDOSCOPE_CHAR_SCANNER_H
@@ -0,0 +1,87 @@
+#ifndef KALEIDOSCOPE_DIAGNOSTIC_H
+#define KALEIDOSCOPE_DIAGNOSTIC_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace kaleidoscope
+{
+enum class DiagnosticCode {
+    // A character that starts no token.
+    kUnknownCharacter,
+
+    // prototypes
+    kExpectedFunctionName,
+    kExpectedLeftParen,
+
+    // expressions
+    kExpectedExpression,
+    kExpectedRightParen,
+    kExpectedCommaOrRightParen,
+    kInvalidNumber,
+
+    // notes
+    kSkippedTokens
+};
+
+constexpr const char* DiagnosticCodeToString(DiagnosticCode code) noexcept
+{
+    switch (code) {
+        case DiagnosticCode::kUnknownCharacter:
+            return "unknown-character";
+
+        // prototypes
+        case DiagnosticCode::kExpectedFunctionName:
+            return "expected-function-name";
+        case DiagnosticCode::kExpectedLeftParen:
+            return "expected-left-paren";
+
+        // expressions
+        case DiagnosticCode::kExpectedExpression:
+            return "expected-expression";
+        case DiagnosticCode::kExpectedRightParen:
+            return "expected-right-paren";
+        case DiagnosticCode::kExpectedCommaOrRightParen:
+            return "expected-comma-or-right-paren";
+        case DiagnosticCode::kInvalidNumber:
+            return "invalid-number";
+
+        // notes
+        case DiagnosticCode::kSkippedTokens:
+            return "skipped-tokens";
+    }
+    return "";
+}
+
+enum class DiagnosticSeverity {
+    kError,
+    // Explains the error before it.
+    kNote
+};
+
+// A syntax error or a note about one, located in the source it was found
+// in.
+struct Diagnostic {
+    DiagnosticCode Code;
+    DiagnosticSeverity Severity = DiagnosticSeverity::kError;
+    // Bytes from the start of the source.
+    size_t Offset = 0;
+    // Both start at 1, columns count bytes.
+    size_t Line = 0;
+    size_t Column = 0;
+    std::string Message;
+};
+
+// Fills in the line and column of diagnostics[first...] from their offsets,
+// in a single pass over `source`. They must be sorted by offset.
+void LocateDiagnostics(std::string_view source,
+                       std::vector<Diagnostic>* diagnostics, size_t first = 0);
+
+// "3:14: error: Expected ')' in prototype [expected-right-paren]"
+// "3:15: note: Skipped 4 tokens up to the next def or extern, ..."
+std::string FormatDiagnostic(const Diagnostic& diagnostic);
+}  // namespace kaleidoscope
+
+#endif  // KALEIDOSCOPE_DIAGNOSTIC_H
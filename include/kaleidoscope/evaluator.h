@@ -0,0 +1,37 @@
+#ifndef KALEIDOSCOPE_EVALUATOR_H
+#define KALEIDOSCOPE_EVALUATOR_H
+
+#include "kaleidoscope/ast/arena.h"
+#include "kaleidoscope/ast/base_expression.h"
+#include "kaleidoscope/symbol_table.h"
+
+#include <optional>
+
+namespace kaleidoscope
+{
+
+namespace evaluator
+{
+// Receives every call made by evaluated code.
+class CallHandler
+{
+   public:
+    virtual ~CallHandler() = default;
+
+    // Returns std::nullopt, after reporting why, if the call failed.
+    virtual std::optional<double> Call(Symbol callee,
+                                       ast::Span<const double> args) = 0;
+};
+
+// Walks `expression` and computes its value, with the same double
+// arithmetic as the generated code but without generating any. `args` are
+// the values of the enclosing function's `params`. Errors, like unknown
+// variable names, are reported to standard error and return std::nullopt.
+std::optional<double> Evaluate(const ast::BaseExpression* expression,
+                               ast::Span<const Symbol> params,
+                               ast::Span<const double> args,
+                               CallHandler* calls);
+}  // namespace evaluator
+}  // namespace kaleidoscope
+
+#endif  // KALEIDOSCOPE_EVALUATOR_H
@@ -0,0 +1,151 @@
+#ifndef KALEIDOSCOPE_IR_GENERATOR_H
+#define KALEIDOSCOPE_IR_GENERATOR_H
+
+#include "kaleidoscope/jit_options.h"
+#include "kaleidoscope/symbol_table.h"
+
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/IR/DataLayout.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Value.h>
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace kaleidoscope
+{
+
+namespace ast
+{
+class BaseExpression;
+struct BinaryOp;
+struct FnCall;
+struct FnPrototype;
+struct Number;
+struct Variable;
+}  // namespace ast
+
+// Arity of every function known to a session, keyed by function name.
+using FunctionArities = SymbolMap<size_t>;
+
+// Functions whose results are cached, see IRGenerator::GenerateFunction.
+struct MemoizationPolicy {
+    SymbolMap<bool> Functions;
+    // Slots of each cache, a power of two.
+    size_t TableSize = 1;
+};
+
+// Fast-math flags of the operations of each function.
+struct FastMathPolicy {
+    FastMathFlags Default;
+    SymbolMap<FastMathFlags> Functions;
+};
+
+// Lowers AST nodes into a module owned by the generator. Calls to functions
+// outside the module are declared from the arities table.
+class IRGenerator
+{
+   public:
+    IRGenerator(const llvm::DataLayout& data_layout,
+                const FunctionArities& known_functions,
+                const MemoizationPolicy* memoization = nullptr,
+                const FastMathPolicy* fast_math = nullptr);
+    IRGenerator(const IRGenerator& t) = delete;
+    IRGenerator& operator=(const IRGenerator&) = delete;
+    ~IRGenerator();
+
+    // Emits `body` as the function described by `proto`. On error the
+    // function is removed from the module and nullptr is returned. Its
+    // arithmetic carries the fast-math flags the policy gives it.
+    //
+    // The body of a memoized function goes to an internal function, and
+    // the function itself first looks the arguments up in its cache, the
+    // external array of 64-bit words named by GetMemoTableName. The cache
+    // starts with the hit and miss counters, padded to a cache line, and
+    // goes on with TableSize slots of a sequence number, the bits of every
+    // argument and the bits of the result. Slots are found by linear
+    // probing over a few neighbours and guarded by their sequence number,
+    // odd while a caller writes them, so any number of threads can share
+    // the cache. The counters are not synchronized and may miss updates
+    // under concurrent calls.
+    llvm::Function* GenerateFunction(const ast::FnPrototype* proto,
+                                     const ast::BaseExpression* body);
+
+    // Emits a copy of a function compiled in another module, so that calls
+    // from this module can be inlined. The copy is always inlined and never
+    // emitted itself, calls that remain go to the original. Returns nullptr
+    // if the module defines the function, or it cannot be lowered. Must
+    // not be used for memoized functions.
+    llvm::Function* GenerateInlineCopy(const ast::FnPrototype* proto,
+                                       const ast::BaseExpression* body);
+
+    // Emits a function that takes the arguments of `callee` as an array of
+    // doubles and calls it, named by GetArrayEntryName. Code that only has
+    // the arguments at run time can call functions of any arity through
+    // it. Returns nullptr if `callee` is unknown.
+    llvm::Function* GenerateArrayEntry(Symbol callee);
+
+    static std::string GetArrayEntryName(std::string_view function_name);
+
+    // Emits `void(const double** columns, double* out, i64 rows)`, named by
+    // GetBatchEntryName, that calls `callee` once per row with the row's
+    // value of each column and stores the result in `out`. The columns are
+    // loaded up front and `out` is marked noalias, so once the callee is
+    // inlined the loop can be vectorized. Returns nullptr if `callee` is
+    // unknown.
+    llvm::Function* GenerateBatchEntry(Symbol callee);
+
+    static std::string GetBatchEntryName(std::string_view function_name);
+
+    static std::string GetMemoTableName(std::string_view function_name);
+
+    // Words of the cache of a memoized function.
+    static constexpr size_t kMemoHitsWord = 0;
+    static constexpr size_t kMemoMissesWord = 1;
+    static size_t GetMemoTableWords(size_t arity, size_t table_size);
+
+    // Turns every function that failed to generate, and every function of
+    // the module that calls one of them, into a declaration. Returns their
+    // names, so the rest of the module can still be compiled. Functions
+    // of other modules that are known to be broken are given in
+    // `broken_elsewhere`, callers of those are dropped as well.
+    std::vector<std::string> DropBrokenFunctions(
+        const std::vector<std::string>& broken_elsewhere = {});
+
+    // Hands the module over, together with its context, and starts an
+    // empty one.
+    llvm::orc::ThreadSafeModule TakeModule(const std::string& module_name);
+
+   private:
+    llvm::Value* GenerateIR(const ast::BaseExpression* expression);
+    llvm::Value* GenerateNumber(const ast::Number* number);
+    llvm::Value* GenerateVariable(const ast::Variable* variable);
+    llvm::Value* GenerateBinaryOp(const ast::BinaryOp* bin_op);
+    llvm::Value* GenerateFnCall(const ast::FnCall* fn_call);
+    llvm::Function* GetFunction(Symbol name);
+    llvm::FastMathFlags GetFastMathFlags(Symbol function) const;
+    void GenerateMemoizedEntry(llvm::Function* fn, llvm::Function* impl);
+
+    void InitializeModule();
+
+   private:
+    const llvm::DataLayout& data_layout_;
+    const FunctionArities& known_functions_;
+    const MemoizationPolicy* memoization_;
+    const FastMathPolicy* fast_math_;
+    std::unique_ptr<llvm::LLVMContext> context_ = nullptr;
+    std::unique_ptr<llvm::Module> module_ = nullptr;
+    std::unique_ptr<llvm::IRBuilder<>> ir_builder_ = nullptr;
+    // Functions of the module, declarations included.
+    SymbolMap<llvm::Function*> functions_;
+    std::vector<std::pair<Symbol, llvm::Value*>> named_values;
+    std::vector<std::string> failed_functions_;
+};
+}  // namespace kaleidoscope
+
+#endif  // KALEIDOSCOPE_IR_GENERATOR_H
@@ -1,10 +1,27 @@
 #ifndef KALEIDOSCOPE_JIT_INTERPRETER_H
 #define KALEIDOSCOPE_JIT_INTERPRETER_H
 
-#include <llvm/IR/IRBuilder.h>
-#include <llvm/IR/LLVMContext.h>
-#include <llvm/IR/Module.h>
-#include <llvm/IR/Value.h>
+#include "kaleidoscope/ast/arena.h"
+#include "kaleidoscope/ast/compilation_unit.h"
+#include "kaleidoscope/evaluator.h"
+#include "kaleidoscope/ir_generator.h"
+#include "kaleidoscope/jit_options.h"
+#include "kaleidoscope/object_cache.h"
+#include "kaleidoscope/symbol_table.h"
+
+#include <llvm/ExecutionEngine/Orc/IndirectionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/LazyReexports.h>
+#include <llvm/Support/ThreadPool.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
 
 namespace kaleidoscope
 {
@@ -12,27 +29,208 @@ namespace kaleidoscope
 namespace ast
 {
 class BaseExpression;
-}
+struct Fn;
+struct FnPrototype;
+}  // namespace ast
+
+// Activity of the tree-walking tier, all zero when tiering is disabled.
+struct TierStats {
+    // Calls to definitions that ran in the tree-walking interpreter.
+    size_t InterpretedCalls = 0;
+    // Definitions that moved on to compiled code.
+    size_t CompiledFunctions = 0;
+};
+
+// Cache activity of a memoized function. Counts may fall short when the
+// function runs on several threads at once.
+struct MemoStats {
+    uint64_t Hits = 0;
+    uint64_t Misses = 0;
+};
 
-class JitInterpreter
+class JitInterpreter : private evaluator::CallHandler
 {
    public:
     JitInterpreter();
+    explicit JitInterpreter(JitOptions options);
     JitInterpreter(const JitInterpreter& t) = delete;
     JitInterpreter& operator=(const JitInterpreter&) = delete;
     ~JitInterpreter();
 
-    void EvaluateExpression(const ast::BaseExpression* expression);
+    // Compiles the expression to native code. Top-level expressions are run
+    // and their result is returned, definitions and externs are registered
+    // in the JIT and return std::nullopt, as does any compilation error.
+    //
+    // Definitions are copied into the session, so the AST can be freed as
+    // soon as this returns, even in lazy and tiered modes where bodies are
+    // only lowered when first called. Tiered mode interprets top-level
+    // expressions instead of compiling them.
+    std::optional<double> EvaluateExpression(
+        const ast::BaseExpression* expression);
+
+    // Compiles every item of the unit as a batch: all the definitions are
+    // lowered into a single module, and can refer to each other regardless
+    // of their order. Returns the result of each top-level expression, in
+    // source order.
+    std::vector<std::optional<double>> EvaluateUnit(
+        const ast::CompilationUnit& unit);
+
+    // Parses `source` into a unit, simplifies it and evaluates it as
+    // EvaluateUnit does. The interpreter keeps the AST, whatever the mode.
+    std::vector<std::optional<double>> EvaluateSource(std::string source);
+
+    // Native code of the function `name`, to be called directly, e.g.
+    // GetFunction<double(double, double)>("f"). Returns nullptr if the
+    // function is unknown, takes another number of arguments or cannot be
+    // compiled. Tiered mode compiles it right away, lazy mode on the
+    // first call.
+    //
+    // Compiled functions share no state but their memo tables, which are
+    // safe to use concurrently, so handles can be called from any number
+    // of threads without locking, as long as no thread calls into the
+    // interpreter itself at the same time. They stay valid for the
+    // lifetime of the interpreter. With redefinition allowed, a handle
+    // always calls the latest version.
+    template <typename Signature>
+    Signature* GetFunction(std::string_view name);
+
+    // Calls the function `name` once per row, taking argument i from
+    // columns[i][row], and stores the results in out[row]. The first batch
+    // of a function compiles a loop over the rows with the function and
+    // everything it calls inlined into it, optimized at O3 and vectorized
+    // for the host whatever the session's level. `out` must not overlap
+    // the columns. Returns false if the function is unknown, takes another
+    // number of arguments or cannot be compiled.
+    bool EvaluateBatch(std::string_view name,
+                       const std::vector<const double*>& columns, size_t rows,
+                       double* out);
+
+    // Identifiers of every AST given to the interpreter must be interned in
+    // this table.
+    SymbolTable& GetSymbolTable();
+
+    // Hit and miss counters of the object cache, all zero when it is
+    // disabled.
+    ObjectCacheStats GetObjectCacheStats() const;
+
+    TierStats GetTierStats() const;
+
+    // Counters of a function listed in JitOptions::MemoizedFunctions, or
+    // std::nullopt for any other function.
+    std::optional<MemoStats> GetMemoStats(std::string_view name) const;
 
    private:
-    llvm::Value* GenerateIR(const ast::BaseExpression* expression);
+    template <typename Signature>
+    struct NativeSignature;
+    template <typename... Args>
+    struct NativeSignature<double(Args...)> {
+        static_assert((std::is_same_v<Args, double> && ...),
+                      "Functions only take doubles");
+        static constexpr size_t kArity = sizeof...(Args);
+    };
+
+    llvm::JITTargetAddress GetFunctionAddress(std::string_view name,
+                                              size_t arity);
+    void DeclareExtern(const ast::FnPrototype* extern_call);
+    bool DeclareDefinition(const ast::Fn* definition);
+    bool IsRedefinitionEnabled() const;
+    void AddInlineCopies(
+        IRGenerator* generator,
+        const std::vector<const ast::BaseExpression*>& bodies) const;
+    struct MemoTable;
+    MemoTable CreateMemoTable(std::string_view body_name, size_t arity);
+    void DropMemoTable(Symbol name);
+    bool AddDefinitions(const std::vector<const ast::Fn*>& definitions,
+                        const std::string& module_name,
+                        bool array_entries = false);
+    bool AddObjectsInParallel(
+        const std::string& module_name,
+        const std::vector<std::unique_ptr<IRGenerator>>& generators);
+    bool AddLazyDefinition(const ast::Fn* definition);
+    bool AddRedefinableDefinition(const ast::Fn* definition);
+    std::vector<std::optional<double>> RunExpressions(
+        const std::vector<const ast::BaseExpression*>& expressions);
+
+    // Tiered mode only.
+    void AddTieredDefinition(const ast::Fn* definition);
+    std::optional<double> Interpret(const ast::BaseExpression* expression);
+    std::optional<double> Call(Symbol callee,
+                               ast::Span<const double> args) override;
+    void CompileTieredFunction(Symbol name);
+    llvm::JITTargetAddress CompileExternEntry(Symbol name);
+
+    llvm::JITTargetAddress CompileBatchEntry(Symbol name);
 
    private:
-    std::unique_ptr<llvm::LLVMContext> context_ = nullptr;
-    std::unique_ptr<llvm::Module> module_ = nullptr;
-    std::unique_ptr<llvm::IRBuilder<>> ir_builder_ = nullptr;
-    std::unordered_map<std::string, llvm::Value*> named_values;
+    // A function as seen by the tree-walking tier. Externs have no
+    // definition. Once compiled, calls go through `Entry`, the address of
+    // its array entry, instead of the interpreter.
+    struct TieredFunction {
+        const ast::Fn* Definition = nullptr;
+        unsigned Calls = 0;
+        llvm::JITTargetAddress Entry = 0;
+        bool CompileFailed = false;
+    };
+
+    // Cache of a memoized function, laid out as IRGenerator expects. The
+    // JIT sees it as an absolute symbol tracked by `Tracker`.
+    struct MemoTable {
+        std::unique_ptr<std::atomic<uint64_t>[]> Words;
+        llvm::orc::ResourceTrackerSP Tracker;
+    };
+
+    // Redefinition only: the version of a function its stub points to,
+    // whose code in impl_dylib_ is tracked by `Tracker`. Version 0 has no
+    // code yet.
+    struct RedefinableFunction {
+        unsigned Version = 0;
+        llvm::orc::ResourceTrackerSP Tracker;
+    };
+
+    JitOptions options_;
+    SymbolTable symbols_;
+    std::unique_ptr<DiskObjectCache> object_cache_ = nullptr;
+    std::unique_ptr<llvm::orc::LLJIT> jit_ = nullptr;
+    // Lazy and redefinition modes only: every definition gets a stub in the
+    // main dylib that leads to its body, kept in impl_dylib_ and compiled
+    // on the first call in lazy mode. Both managers refer to the JIT
+    // session, so they are declared after it.
+    std::unique_ptr<llvm::orc::LazyCallThroughManager> lazy_call_through_ =
+        nullptr;
+    std::unique_ptr<llvm::orc::IndirectStubsManager> stubs_ = nullptr;
+    llvm::orc::JITDylib* impl_dylib_ = nullptr;
+    // Only with compile threads: lowers and compiles the modules of a unit
+    // in parallel, outside of the JIT.
+    std::unique_ptr<llvm::orc::JITTargetMachineBuilder>
+        codegen_target_builder_ = nullptr;
+    std::unique_ptr<llvm::ThreadPool> codegen_pool_ = nullptr;
+    FunctionArities function_arities_;
+    // A copy of every definition, which batch entries lower again. Callers
+    // may free their ASTs as soon as an item is evaluated.
+    ast::Arena definition_nodes_;
+    SymbolMap<const ast::Fn*> definitions_;
+    SymbolMap<llvm::JITTargetAddress> batch_entries_;
+    // Tracks every batch entry, which inline the functions they call and
+    // so are dropped when one of them is redefined.
+    llvm::orc::ResourceTrackerSP batch_tracker_ = nullptr;
+    // Null when no function is memoized.
+    std::unique_ptr<MemoizationPolicy> memoization_ = nullptr;
+    // Null when every operation keeps IEEE semantics.
+    std::unique_ptr<FastMathPolicy> fast_math_ = nullptr;
+    SymbolMap<MemoTable> memo_tables_;
+    SymbolMap<RedefinableFunction> redefinable_functions_;
+    SymbolMap<TieredFunction> tiered_functions_;
+    TierStats tier_stats_;
+    // Units parsed by EvaluateSource.
+    std::vector<ast::CompilationUnit> source_units_;
 };
+
+template <typename Signature>
+Signature* JitInterpreter::GetFunction(std::string_view name)
+{
+    return llvm::jitTargetAddressToFunction<Signature*>(
+        GetFunctionAddress(name, NativeSignature<Signature>::kArity));
+}
 }  // namespace kaleidoscope
 
-#endif  // KALEIDOSCOPE_JIT_INTERPRETER_H
\ No newline at end of file
+#endif  // KALEIDOSCOPE_JIT_INTERPRETER_H
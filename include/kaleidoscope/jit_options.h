@@ -0,0 +1,118 @@
+#ifndef KALEIDOSCOPE_JIT_OPTIONS_H
+#define KALEIDOSCOPE_JIT_OPTIONS_H
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace kaleidoscope
+{
+enum class OptimizationLevel {
+    kO0,
+    kO1,
+    kO2,
+    kO3,
+};
+
+constexpr const char* OptimizationLevelToString(OptimizationLevel l) noexcept
+{
+    switch (l) {
+        case OptimizationLevel::kO0:
+            return "O0";
+        case OptimizationLevel::kO1:
+            return "O1";
+        case OptimizationLevel::kO2:
+            return "O2";
+        case OptimizationLevel::kO3:
+            return "O3";
+    }
+    return "";
+}
+
+// IEEE guarantees that floating point operations may give up, see the LLVM
+// fast-math flags of the same names. Only worth it for code that tolerates
+// results that differ in the last bits, or never sees NaNs or infinities.
+struct FastMathFlags {
+    // Fuse a multiplication and an addition into one FMA, rounded once.
+    bool Contract = false;
+    // Regroup operations, as in (a + b) + c to a + (b + c).
+    bool Reassoc = false;
+    // Assume no operand nor result is NaN, or anything may come out.
+    bool NoNaNs = false;
+    // Assume no operand nor result is infinite.
+    bool NoInfs = false;
+
+    bool Any() const { return Contract || Reassoc || NoNaNs || NoInfs; }
+};
+
+struct JitOptions {
+    // Pipeline run over every module before it is compiled to machine code.
+    // kO0 skips optimization entirely, which is the cheapest choice for
+    // interactive sessions.
+    OptimizationLevel OptLevel = OptimizationLevel::kO0;
+
+    // Defer lowering and compiling each definition until it is first
+    // called, so functions that are never used cost no codegen at all.
+    bool LazyCompilation = false;
+
+    // Directory of the persistent object cache. Compiled definitions are
+    // stored there and reused by later sessions. Empty disables the cache.
+    std::string ObjectCacheDirectory;
+
+    // Threads that lower and compile definitions. With more than one, the
+    // definitions of a unit are split across that many modules, each with
+    // its own context, lowered on a thread pool and compiled concurrently.
+    // Calls between the modules are only inlined below InlineThreshold. 0
+    // and 1 do everything on the calling thread.
+    unsigned CompileThreads = 0;
+
+    // Calls after which a definition is compiled. Until then it runs in a
+    // tree-walking interpreter, which costs nothing up front, and so does
+    // every top-level expression. A definition is compiled together with
+    // the interpreted functions it calls, and errors in its body only show
+    // up when it runs. 0 compiles every definition as soon as it is made.
+    // Takes precedence over LazyCompilation.
+    unsigned TierUpThreshold = 0;
+
+    // Definitions whose compiled code caches its results, keyed by the
+    // bits of the arguments. Functions are pure unless they reach an
+    // extern with side effects, which must not be memoized. Only pays off
+    // for costly functions called again with the same arguments. Calls
+    // from the tree-walking tier and batch loops are never cached.
+    std::vector<std::string> MemoizedFunctions;
+
+    // Results kept per memoized function, rounded up to a power of two.
+    // Once full, new results evict old ones.
+    size_t MemoTableSize = 4096;
+
+    // Let a definition be replaced by a new one with the same number of
+    // arguments. Only the new body is compiled: every function is called
+    // through a stub that is pointed at its latest version, and the code of
+    // the previous version is freed right away, so no thread may be running
+    // it at the time. A function whose body fails to compile keeps its
+    // previous version, or returns NaN if it never had one. Every
+    // definition is compiled on its own, so CompileThreads is ignored, and
+    // so is this option in tiered mode.
+    bool AllowRedefinition = false;
+
+    // Fast-math flags of every operation of compiled code, top-level
+    // expressions included. The tree-walking tier always evaluates with
+    // IEEE semantics, so results may change once a function is compiled.
+    FastMathFlags FastMath;
+
+    // Flags of the functions named here, in place of FastMath.
+    std::unordered_map<std::string, FastMathFlags> FunctionFastMath;
+
+    // Functions of at most this many AST nodes, prototype excluded, are
+    // inlined into callers compiled after them, in any mode and at any
+    // optimization level, so that chains of small definitions collapse.
+    // Each caller lowers its own copy of them. Memoized functions are
+    // never inlined, and nothing is when redefinition is allowed. 0
+    // disables inlining across items.
+    size_t InlineThreshold = 0;
+};
+
+}  // namespace kaleidoscope
+
+#endif  // KALEIDOSCOPE_JIT_OPTIONS_H
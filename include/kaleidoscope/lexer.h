@@ -6,7 +6,9 @@
 
 #include <tl/expected.hpp>
 
+#include <cstddef>
 #include <optional>
+#include <string_view>
 
 namespace kaleidoscope
 {
@@ -17,7 +19,15 @@ class Lexer
 
     virtual tl::expected<Token, LexerError> PeekToken() = 0;
 
+    // Moves past the peeked token. Past an error, skips the character that
+    // could not be lexed.
     virtual void ConsumeToken() = 0;
+
+    // Bytes from the start of the source to the peeked token, to the
+    // character that could not be lexed, or to the end at EOF.
+    virtual size_t GetOffset() = 0;
+
+    virtual std::string_view GetSource() const = 0;
 };
 }  // namespace kaleidoscope
 
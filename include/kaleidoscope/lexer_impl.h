@@ -1,8 +1,10 @@
 #ifndef KALEIDOSCOPE_LEXER_IMPL_H
 #define KALEIDOSCOPE_LEXER_IMPL_H
 
+#include "kaleidoscope/char_scanner.h"
 #include "kaleidoscope/lexer.h"
 #include "kaleidoscope/lexer_error.h"
+#include "kaleidoscope/source_buffer.h"
 #include "kaleidoscope/token.h"
 
 #include <tl/expected.hpp>
@@ -20,6 +22,8 @@ class LexerImpl : public Lexer
     LexerImpl() = delete;
     ~LexerImpl() override;
     explicit LexerImpl(std::string input);
+    // Tokens point straight into the source, no copy of it is made.
+    explicit LexerImpl(SourceBuffer source);
     LexerImpl(const LexerImpl& t) = delete;
     LexerImpl& operator=(const LexerImpl&) = delete;
 
@@ -27,11 +31,23 @@ class LexerImpl : public Lexer
 
     void ConsumeToken() override;
 
+    size_t GetOffset() override;
+
+    std::string_view GetSource() const override;
+
+   private:
+    tl::expected<Token, LexerError> LexToken();
+
    private:
-    std::string input_;
+    SourceBuffer source_;
     std::string_view input_to_process_;
+    const scanner::Kernels& kernels_;
+    // Whether a time trace was being recorded when the lexer was created.
+    const bool trace_tokens_;
 
     std::optional<tl::expected<Token, LexerError>> next_token_ = std::nullopt;
+    // Where next_token_ starts.
+    size_t next_token_offset_ = 0;
 };
 }  // namespace kaleidoscope
 
@@ -0,0 +1,60 @@
+#ifndef KALEIDOSCOPE_OBJECT_CACHE_H
+#define KALEIDOSCOPE_OBJECT_CACHE_H
+
+#include "kaleidoscope/jit_options.h"
+
+#include <llvm/Support/MemoryBuffer.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+namespace llvm
+{
+class Module;
+class TargetMachine;
+}  // namespace llvm
+
+namespace kaleidoscope
+{
+
+struct ObjectCacheStats {
+    size_t Hits = 0;
+    size_t Misses = 0;
+};
+
+// Content addressed store of compiled object files in a local directory.
+// Objects are keyed by a hash of the unoptimized module IR together with
+// everything else that changes the generated code, so an unchanged
+// definition maps to the same object across processes.
+class DiskObjectCache
+{
+   public:
+    DiskObjectCache() = delete;
+    explicit DiskObjectCache(std::string directory);
+    DiskObjectCache(const DiskObjectCache& t) = delete;
+    DiskObjectCache& operator=(const DiskObjectCache&) = delete;
+    ~DiskObjectCache();
+
+    static std::string ComputeKey(const llvm::Module& module,
+                                  const llvm::TargetMachine& target_machine,
+                                  OptimizationLevel level);
+
+    // Returns nullptr, and counts a miss, if there is no object for the key.
+    std::unique_ptr<llvm::MemoryBuffer> Lookup(const std::string& key);
+
+    void Store(const std::string& key, llvm::MemoryBufferRef object);
+
+    ObjectCacheStats GetStats() const;
+
+   private:
+    std::string GetObjectPath(const std::string& key) const;
+
+   private:
+    std::string directory_;
+    std::atomic<size_t> hits_ = 0;
+    std::atomic<size_t> misses_ = 0;
+};
+}  // namespace kaleidoscope
+
+#endif  // KALEIDOSCOPE_OBJECT_CACHE_H
@@ -0,0 +1,27 @@
+#ifndef KALEIDOSCOPE_OPTIMIZER_H
+#define KALEIDOSCOPE_OPTIMIZER_H
+
+#include "kaleidoscope/jit_options.h"
+
+namespace llvm
+{
+class Module;
+class TargetMachine;
+}  // namespace llvm
+
+namespace kaleidoscope
+{
+
+namespace optimizer
+{
+// Runs the new pass manager default pipeline for `level` over the module.
+// At kO0 it only runs when functions must be inlined, see
+// IRGenerator::GenerateInlineCopy.
+// When a target machine is given, its cost model drives target dependent
+// passes such as the vectorizers.
+void OptimizeModule(llvm::Module& module, OptimizationLevel level,
+                    llvm::TargetMachine* target_machine = nullptr);
+}  // namespace optimizer
+}  // namespace kaleidoscope
+
+#endif  // KALEIDOSCOPE_OPTIMIZER_H
@@ -1,18 +1,48 @@
 #ifndef KALEIDOSCOPE_PARSER_H
 #define KALEIDOSCOPE_PARSER_H
 
+#include "ast/arena.h"
 #include "ast/base_expression.h"
+#include "ast/compilation_unit.h"
+#include "diagnostic.h"
 
-#include <memory>
+#include <string_view>
+#include <vector>
 
 namespace kaleidoscope
 {
 
 class Lexer;
+class SymbolTable;
 
 namespace parser
 {
-std::unique_ptr<ast::BaseExpression> ParseNextExpression(Lexer* lexer);
+// Syntax errors are appended to `diagnostics`, located in the source of the
+// lexer, or printed to std::cerr when it is null. After an error, parsing
+// resumes at the next `def` or `extern`, so the rest of a source is checked
+// in the same pass.
+
+// Parses the next top-level item, allocating its nodes from `arena` and
+// interning its identifiers in `symbols`. Returns nullptr at the end of the
+// input or on error.
+const ast::BaseExpression* ParseNextExpression(
+    Lexer* lexer, ast::Arena* arena, SymbolTable* symbols,
+    std::vector<Diagnostic>* diagnostics = nullptr);
+
+// Parses every top-level item until the end of the input. Items that fail
+// to parse are left out.
+ast::CompilationUnit ParseCompilationUnit(
+    Lexer* lexer, SymbolTable* symbols,
+    std::vector<Diagnostic>* diagnostics = nullptr);
+
+// Same as ParseCompilationUnit over all of `source`, but splits it at
+// top-level `def` and `extern` keywords and parses the pieces on up to
+// `threads` threads. Items and diagnostics are in source order, and the
+// same as those of a sequential parse: errors never make an item span
+// pieces.
+ast::CompilationUnit ParseCompilationUnitInParallel(
+    std::string_view source, SymbolTable* symbols, unsigned threads,
+    std::vector<Diagnostic>* diagnostics = nullptr);
 }
 }  // namespace kaleidoscope
 
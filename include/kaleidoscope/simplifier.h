@@ -0,0 +1,28 @@
+#ifndef KALEIDOSCOPE_SIMPLIFIER_H
+#define KALEIDOSCOPE_SIMPLIFIER_H
+
+#include "kaleidoscope/ast/arena.h"
+#include "kaleidoscope/ast/base_expression.h"
+#include "kaleidoscope/ast/compilation_unit.h"
+
+namespace kaleidoscope
+{
+
+namespace simplifier
+{
+// Folds binary operations over literals and removes operands that cannot
+// change the result under IEEE arithmetic: `x * 1`, `1 * x`, `x - 0`,
+// `x + -0` and `-0 + x`. `x + 0` is kept, it turns -0 into 0. Operations are
+// never reassociated, so `x + 1 + 2` stays as written.
+//
+// Nodes are immutable, changed subtrees are rebuilt in `arena` and the
+// unchanged ones are shared. Returns `expression` when nothing changes.
+const ast::BaseExpression* SimplifyExpression(
+    const ast::BaseExpression* expression, ast::Arena* arena);
+
+// Simplifies every item of the unit, allocating from its own arena.
+void SimplifyCompilationUnit(ast::CompilationUnit* unit);
+}  // namespace simplifier
+}  // namespace kaleidoscope
+
+#endif  // KALEIDOSCOPE_SIMPLIFIER_H
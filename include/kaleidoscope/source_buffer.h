@@ -0,0 +1,54 @@
+#ifndef KALEIDOSCOPE_SOURCE_BUFFER_H
+#define KALEIDOSCOPE_SOURCE_BUFFER_H
+
+#include <tl/expected.hpp>
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+namespace kaleidoscope
+{
+// Read-only source text. Files are mapped into memory rather than copied,
+// so loading one costs no heap allocation and its pages are shared with
+// every other process reading the same file.
+class SourceBuffer
+{
+   public:
+    SourceBuffer() = delete;
+    ~SourceBuffer();
+    SourceBuffer(const SourceBuffer& t) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+    SourceBuffer(SourceBuffer&& other) noexcept;
+    SourceBuffer& operator=(SourceBuffer&& other) noexcept;
+
+    // Maps the file at `path`. "-" reads the standard input instead, as does
+    // anything that cannot be mapped, like pipes.
+    static tl::expected<SourceBuffer, std::error_code> FromFile(
+        const std::string& path);
+
+    static SourceBuffer FromString(std::string contents);
+
+    // Nothing is copied, `contents` must outlive the buffer.
+    static SourceBuffer FromView(std::string_view contents);
+
+    std::string_view Contents() const;
+
+    bool IsMapped() const;
+
+   private:
+    explicit SourceBuffer(std::string contents);
+    SourceBuffer(const char* mapped, size_t size);
+
+    void Release();
+
+   private:
+    std::string owned_;
+    std::string_view borrowed_;
+    const char* mapped_ = nullptr;
+    size_t mapped_size_ = 0;
+};
+}  // namespace kaleidoscope
+
+#endif  // KALEIDOSCOPE_SOURCE_BUFFER_H
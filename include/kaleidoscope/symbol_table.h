@@ -0,0 +1,124 @@
+#ifndef KALEIDOSCOPE_SYMBOL_TABLE_H
+#define KALEIDOSCOPE_SYMBOL_TABLE_H
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace kaleidoscope
+{
+// Handle to an identifier interned in a SymbolTable. Symbols of the same
+// table are equal exactly when their spellings are, so comparing them is a
+// pointer compare, and their ids index dense tables.
+class Symbol
+{
+   public:
+    Symbol() = default;
+
+    uint32_t GetId() const { return entry_->Id; }
+    std::string_view GetSpelling() const { return entry_->Spelling; }
+    bool IsValid() const { return entry_ != nullptr; }
+
+    friend bool operator==(Symbol lhs, Symbol rhs)
+    {
+        return lhs.entry_ == rhs.entry_;
+    }
+    friend bool operator!=(Symbol lhs, Symbol rhs) { return !(lhs == rhs); }
+
+   private:
+    friend class SymbolTable;
+
+    struct Entry {
+        std::string_view Spelling;
+        uint32_t Id;
+    };
+
+    explicit Symbol(const Entry* entry) : entry_(entry) {}
+
+    const Entry* entry_ = nullptr;
+};
+
+// Session-wide interner. Spellings are copied into the table, so symbols
+// stay valid after the source they were lexed from is gone, for as long as
+// the table lives.
+//
+// A table is not thread-safe by itself. Threads that intern at the same
+// time each go through their own front table instead.
+class SymbolTable
+{
+   public:
+    SymbolTable();
+    // Front for `shared` on a single thread. Spellings it has seen before
+    // are resolved without locking, new ones are interned in `shared`
+    // under its lock. Symbols are those of `shared`. While fronts are in
+    // use, `shared` must not be used directly.
+    explicit SymbolTable(SymbolTable* shared);
+    ~SymbolTable();
+    SymbolTable(const SymbolTable& t) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+
+    Symbol Intern(std::string_view spelling);
+
+    // Returns an invalid symbol if `spelling` was never interned.
+    Symbol Find(std::string_view spelling) const;
+
+    size_t GetSymbolCount() const;
+
+   private:
+    Symbol InternShared(std::string_view spelling);
+
+   private:
+    SymbolTable* shared_ = nullptr;
+    std::mutex mutex_;
+    // Deques never move their elements, views into them stay valid.
+    std::deque<std::string> spellings_;
+    std::deque<Symbol::Entry> entries_;
+    std::unordered_map<std::string_view, const Symbol::Entry*> index_;
+};
+
+// Map keyed by symbols of a single table, stored as an array indexed by
+// symbol id.
+template <typename T>
+class SymbolMap
+{
+   public:
+    const T* Find(Symbol symbol) const
+    {
+        const size_t id = symbol.GetId();
+        if (id >= slots_.size() || !slots_[id]) return nullptr;
+        return &*slots_[id];
+    }
+
+    T* Find(Symbol symbol)
+    {
+        const size_t id = symbol.GetId();
+        if (id >= slots_.size() || !slots_[id]) return nullptr;
+        return &*slots_[id];
+    }
+
+    bool Contains(Symbol symbol) const { return Find(symbol) != nullptr; }
+
+    void Set(Symbol symbol, T value)
+    {
+        const size_t id = symbol.GetId();
+        if (id >= slots_.size()) slots_.resize(id + 1);
+        slots_[id] = std::move(value);
+    }
+
+    void Erase(Symbol symbol)
+    {
+        const size_t id = symbol.GetId();
+        if (id < slots_.size()) slots_[id].reset();
+    }
+
+   private:
+    std::vector<std::optional<T>> slots_;
+};
+}  // namespace kaleidoscope
+
+#endif  // KALEIDOSCOPE_SYMBOL_TABLE_H
@@ -0,0 +1,24 @@
+#ifndef KALEIDOSCOPE_TIME_TRACE_H
+#define KALEIDOSCOPE_TIME_TRACE_H
+
+#include <string>
+
+namespace kaleidoscope
+{
+
+namespace time_trace
+{
+// Starts recording how long every compiler phase takes on the calling
+// thread: lexing, parsing, IR generation, optimization passes, machine code
+// generation and running. Scopes shorter than `granularity_us` microseconds
+// are left out of the timeline, but still count towards the per-phase
+// totals. Lexers must be created after this call to be traced.
+void Begin(unsigned granularity_us = 500);
+
+// Writes what was recorded as a Chrome trace, which chrome://tracing and
+// Perfetto can open, and stops recording. Returns false on I/O errors.
+bool Finish(const std::string& path);
+}  // namespace time_trace
+}  // namespace kaleidoscope
+
+#endif  // KALEIDOSCOPE_TIME_TRACE_H
@@ -0,0 +1,61 @@
+#ifndef KALEIDOSCOPE_VM_INTERPRETER_H
+#define KALEIDOSCOPE_VM_INTERPRETER_H
+
+#include "kaleidoscope/bytecode.h"
+#include "kaleidoscope/symbol_table.h"
+
+#include <optional>
+#include <vector>
+
+namespace kaleidoscope
+{
+
+namespace ast
+{
+class BaseExpression;
+struct CompilationUnit;
+struct Fn;
+struct FnPrototype;
+}  // namespace ast
+
+// Runs items on a register bytecode virtual machine instead of generating
+// machine code. Startup and compiling cost next to nothing and no code
+// generator is linked in, at the price of slower execution than the JIT.
+class VmInterpreter
+{
+   public:
+    VmInterpreter();
+    VmInterpreter(const VmInterpreter& t) = delete;
+    VmInterpreter& operator=(const VmInterpreter&) = delete;
+    ~VmInterpreter();
+
+    // Same contract as JitInterpreter::EvaluateExpression. Bytecode does
+    // not refer to the AST, which can go away right after.
+    std::optional<double> EvaluateExpression(
+        const ast::BaseExpression* expression);
+
+    // Same contract as JitInterpreter::EvaluateUnit.
+    std::vector<std::optional<double>> EvaluateUnit(
+        const ast::CompilationUnit& unit);
+
+    // Identifiers of every AST given to the interpreter must be interned in
+    // this table.
+    SymbolTable& GetSymbolTable();
+
+   private:
+    void DeclareExtern(const ast::FnPrototype* extern_call);
+    bool DeclareDefinition(const ast::Fn* definition);
+    void AddDefinitions(const std::vector<const ast::Fn*>& definitions);
+    std::optional<double> RunExpression(const ast::BaseExpression* expression);
+    std::optional<double> Run(const bytecode::Function& entry);
+
+   private:
+    SymbolTable symbols_;
+    bytecode::FunctionIndices function_indices_;
+    std::vector<bytecode::Function> functions_;
+    // Registers of every active frame, kept between runs.
+    std::vector<double> stack_;
+};
+}  // namespace kaleidoscope
+
+#endif  // KALEIDOSCOPE_VM_INTERPRETER_H
@@ -0,0 +1,262 @@
+#include "kaleidoscope/aot_compiler.h"
+
+#include "kaleidoscope/ast/base_expression.h"
+#include "kaleidoscope/ast/compilation_unit.h"
+#include "kaleidoscope/ast/fn.h"
+#include "kaleidoscope/ast/fn_prototype.h"
+#include "kaleidoscope/optimizer.h"
+
+#include <fmt/core.h>
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/Object/ArchiveWriter.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include <cctype>
+#include <iostream>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace kaleidoscope
+{
+
+namespace
+{
+llvm::ExitOnError ExitOnAotError("kaleidoscope: ");
+
+std::unique_ptr<llvm::TargetMachine> CreateTargetMachine(
+    const AotOptions& options)
+{
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+
+    llvm::orc::JITTargetMachineBuilder target_builder =
+        options.TuneForHost
+            ? ExitOnAotError(llvm::orc::JITTargetMachineBuilder::detectHost())
+            : llvm::orc::JITTargetMachineBuilder(
+                  llvm::Triple(llvm::sys::getProcessTriple()));
+    // Libraries may end up in position independent executables or shared
+    // objects.
+    target_builder.setRelocationModel(llvm::Reloc::PIC_);
+    switch (options.OptLevel) {
+        case OptimizationLevel::kO0:
+            target_builder.setCodeGenOptLevel(llvm::CodeGenOpt::None);
+            break;
+        case OptimizationLevel::kO1:
+            target_builder.setCodeGenOptLevel(llvm::CodeGenOpt::Less);
+            break;
+        case OptimizationLevel::kO2:
+            target_builder.setCodeGenOptLevel(llvm::CodeGenOpt::Default);
+            break;
+        case OptimizationLevel::kO3:
+            target_builder.setCodeGenOptLevel(llvm::CodeGenOpt::Aggressive);
+            break;
+    }
+    return ExitOnAotError(target_builder.createTargetMachine());
+}
+
+bool WriteFile(const std::string& path, llvm::StringRef contents)
+{
+    std::error_code ec;
+    llvm::raw_fd_ostream out(path, ec);
+    if (!ec) {
+        out << contents;
+        out.close();
+        ec = out.error();
+    }
+    if (ec) {
+        std::cerr << "Could not write " << path << ": " << ec.message()
+                  << '\n';
+        return false;
+    }
+    return true;
+}
+
+// FORMULAS_H for formulas.h.
+std::string GetIncludeGuard(const std::string& path)
+{
+    std::string guard;
+    for (char c : llvm::sys::path::filename(path)) {
+        guard += std::isalnum(static_cast<unsigned char>(c))
+                     ? static_cast<char>(
+                           std::toupper(static_cast<unsigned char>(c)))
+                     : '_';
+    }
+    if (guard.empty() || std::isdigit(static_cast<unsigned char>(guard[0]))) {
+        guard.insert(0, "KS_");
+    }
+    return guard;
+}
+}  // namespace
+
+AotCompiler::AotCompiler() : AotCompiler(AotOptions()) {}
+
+AotCompiler::AotCompiler(AotOptions options)
+    : options_(options),
+      target_machine_(CreateTargetMachine(options_)),
+      data_layout_(target_machine_->createDataLayout()),
+      generator_(std::make_unique<IRGenerator>(
+          data_layout_, function_arities_, /*memoization=*/nullptr,
+          &fast_math_))
+{
+    fast_math_.Default = options_.FastMath;
+}
+
+AotCompiler::~AotCompiler() = default;
+
+bool AotCompiler::AddUnit(const ast::CompilationUnit& unit)
+{
+    llvm::TimeTraceScope scope("AddUnit");
+    if (object_) {
+        std::cerr << "Units cannot be added once the library is compiled\n";
+        return false;
+    }
+
+    // Declare every item up front, so that any item can refer to functions
+    // defined later in the unit.
+    bool ok = true;
+    std::vector<const ast::Fn*> definitions;
+    for (const ast::BaseExpression* item : unit.Items) {
+        if (const ast::FnPrototype* extern_call =
+                ast::dyn_cast<ast::FnPrototype>(item)) {
+            function_arities_.Set(extern_call->Name,
+                                  extern_call->Args.size());
+        } else if (const ast::Fn* definition =
+                       ast::dyn_cast<ast::Fn>(item)) {
+            const Symbol name = definition->Proto->Name;
+            if (function_arities_.Contains(name)) {
+                std::cerr << "Function " << name.GetSpelling()
+                          << " cannot be redefined\n";
+                ok = false;
+                continue;
+            }
+            function_arities_.Set(name, definition->Proto->Args.size());
+            definitions.push_back(definition);
+        } else {
+            std::cerr << "Top-level expressions cannot be compiled ahead of "
+                         "time\n";
+            ok = false;
+        }
+    }
+
+    {
+        llvm::TimeTraceScope generate_scope("GenerateIR");
+        for (const ast::Fn* definition : definitions) {
+            generator_->GenerateFunction(definition->Proto, definition->Body);
+        }
+    }
+    const std::vector<std::string> dropped = generator_->DropBrokenFunctions();
+    const std::unordered_set<std::string_view> broken(dropped.begin(),
+                                                      dropped.end());
+    for (const ast::Fn* definition : definitions) {
+        const Symbol name = definition->Proto->Name;
+        if (broken.count(name.GetSpelling())) {
+            // Forgotten, so that a later unit can define it again.
+            function_arities_.Erase(name);
+            ok = false;
+        } else {
+            definitions_.push_back(name);
+        }
+    }
+    return ok;
+}
+
+const llvm::MemoryBuffer* AotCompiler::Compile()
+{
+    if (object_) return object_.get();
+
+    llvm::TimeTraceScope scope("CompileLibrary");
+    llvm::orc::ThreadSafeModule module = generator_->TakeModule("library");
+    module.withModuleDo([&](llvm::Module& m) {
+        m.setTargetTriple(target_machine_->getTargetTriple().str());
+        optimizer::OptimizeModule(m, options_.OptLevel,
+                                  target_machine_.get());
+        llvm::TimeTraceScope codegen_scope("CodeGen");
+        auto object = llvm::orc::SimpleCompiler(*target_machine_)(m);
+        if (object) {
+            object_ = std::move(*object);
+        } else {
+            std::cerr << "Could not compile library: "
+                      << llvm::toString(object.takeError()) << '\n';
+        }
+    });
+    return object_.get();
+}
+
+bool AotCompiler::WriteObject(const std::string& path)
+{
+    const llvm::MemoryBuffer* object = Compile();
+    return object && WriteFile(path, object->getBuffer());
+}
+
+bool AotCompiler::WriteArchive(const std::string& path)
+{
+    const llvm::MemoryBuffer* object = Compile();
+    if (!object) return false;
+
+    const std::string member_name =
+        (llvm::sys::path::stem(path) + ".o").str();
+    std::vector<llvm::NewArchiveMember> members;
+    members.emplace_back(
+        llvm::MemoryBufferRef(object->getBuffer(), member_name));
+    members.back().MemberName = member_name;
+    const llvm::object::Archive::Kind kind =
+        target_machine_->getTargetTriple().isOSDarwin()
+            ? llvm::object::Archive::K_DARWIN
+            : llvm::object::Archive::K_GNU;
+    // Deterministic, so that the same source yields the same library.
+    if (llvm::Error err = llvm::writeArchive(path, members,
+                                             /*WriteSymtab=*/true, kind,
+                                             /*Deterministic=*/true,
+                                             /*Thin=*/false)) {
+        std::cerr << "Could not write " << path << ": "
+                  << llvm::toString(std::move(err)) << '\n';
+        return false;
+    }
+    return true;
+}
+
+bool AotCompiler::WriteHeader(const std::string& path) const
+{
+    const std::string guard = GetIncludeGuard(path);
+    std::string header = fmt::format(
+        "// Generated by the Kaleidoscope compiler, do not edit.\n"
+        "#ifndef {0}\n"
+        "#define {0}\n"
+        "\n"
+        "#ifdef __cplusplus\n"
+        "extern \"C\" {{\n"
+        "#endif\n"
+        "\n",
+        guard);
+    for (const Symbol name : definitions_) {
+        std::string params;
+        for (size_t i = 0; i < *function_arities_.Find(name); ++i) {
+            params += i == 0 ? "double" : ", double";
+        }
+        header += fmt::format("double {}({});\n", name.GetSpelling(),
+                              params.empty() ? "void" : params);
+    }
+    header += fmt::format(
+        "\n"
+        "#ifdef __cplusplus\n"
+        "}}\n"
+        "#endif\n"
+        "\n"
+        "#endif  // {}\n",
+        guard);
+    return WriteFile(path, header);
+}
+
+SymbolTable& AotCompiler::GetSymbolTable() { return symbols_; }
+
+}  // namespace kaleidoscope
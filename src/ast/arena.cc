@@ -0,0 +1,79 @@
+#include "kaleidoscope/ast/arena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+
+namespace kaleidoscope::ast
+{
+namespace
+{
+// A one-line item fits in the first chunk, chunks then double in size so
+// that large files need few of them.
+constexpr size_t kFirstChunkSize = 4 * 1024;
+constexpr size_t kMaxChunkSize = 1024 * 1024;
+}  // namespace
+
+Arena::Arena() : next_chunk_size_(kFirstChunkSize) {}
+
+Arena::~Arena() = default;
+
+Arena::Arena(Arena&& other) noexcept
+    : chunks_(std::move(other.chunks_)),
+      cursor_(std::exchange(other.cursor_, nullptr)),
+      chunk_end_(std::exchange(other.chunk_end_, nullptr)),
+      next_chunk_size_(std::exchange(other.next_chunk_size_, kFirstChunkSize)),
+      bytes_used_(std::exchange(other.bytes_used_, 0))
+{
+}
+
+Arena& Arena::operator=(Arena&& other) noexcept
+{
+    if (this != &other) {
+        chunks_ = std::move(other.chunks_);
+        cursor_ = std::exchange(other.cursor_, nullptr);
+        chunk_end_ = std::exchange(other.chunk_end_, nullptr);
+        next_chunk_size_ =
+            std::exchange(other.next_chunk_size_, kFirstChunkSize);
+        bytes_used_ = std::exchange(other.bytes_used_, 0);
+    }
+    return *this;
+}
+
+void Arena::Adopt(Arena&& other)
+{
+    // Allocation carries on in the current chunk, the adopted ones are only
+    // kept alive.
+    chunks_.insert(chunks_.end(),
+                   std::make_move_iterator(other.chunks_.begin()),
+                   std::make_move_iterator(other.chunks_.end()));
+    bytes_used_ += other.bytes_used_;
+    other = Arena();
+}
+
+size_t Arena::BytesUsed() const { return bytes_used_; }
+
+void* Arena::Allocate(size_t size, size_t alignment)
+{
+    const auto address = reinterpret_cast<uintptr_t>(cursor_);
+    size_t padding = (alignment - address % alignment) % alignment;
+    const auto available = static_cast<size_t>(chunk_end_ - cursor_);
+    if (!cursor_ || padding + size > available) {
+        // Chunks come from operator new[], which is aligned for any node.
+        // They are left uninitialized.
+        const size_t chunk_size = std::max(next_chunk_size_, size);
+        chunks_.emplace_back(new std::byte[chunk_size]);
+        cursor_ = chunks_.back().get();
+        chunk_end_ = cursor_ + chunk_size;
+        next_chunk_size_ = std::min(next_chunk_size_ * 2, kMaxChunkSize);
+        padding = 0;
+    }
+
+    void* allocation = cursor_ + padding;
+    cursor_ += padding + size;
+    bytes_used_ += padding + size;
+    return allocation;
+}
+
+}  // namespace kaleidoscope::ast
@@ -4,9 +4,9 @@
 
 namespace kaleidoscope::ast
 {
-BinaryOp::BinaryOp(char op, std::unique_ptr<BaseExpression> lhs_op,
-                   std::unique_ptr<BaseExpression> rhs_op)
-    : Op(op), LhsOp(std::move(lhs_op)), RhsOp(std::move(rhs_op))
+BinaryOp::BinaryOp(char op, const BaseExpression* lhs_op,
+                   const BaseExpression* rhs_op)
+    : BaseExpression(kKind), Op(op), LhsOp(lhs_op), RhsOp(rhs_op)
 {
 }
 
@@ -0,0 +1,55 @@
+#include "kaleidoscope/ast/clone.h"
+
+#include "kaleidoscope/ast/binary_op.h"
+#include "kaleidoscope/ast/fn.h"
+#include "kaleidoscope/ast/fn_call.h"
+#include "kaleidoscope/ast/fn_prototype.h"
+#include "kaleidoscope/ast/number.h"
+#include "kaleidoscope/ast/variable.h"
+
+#include <vector>
+
+namespace kaleidoscope::ast
+{
+namespace
+{
+const FnPrototype* CloneFnPrototype(const FnPrototype* proto, Arena* arena)
+{
+    const std::vector<Symbol> args(proto->Args.begin(), proto->Args.end());
+    return arena->New<FnPrototype>(proto->Name, arena->CopyArray(args));
+}
+}  // namespace
+
+const BaseExpression* Clone(const BaseExpression* expression, Arena* arena)
+{
+    switch (expression->GetKind()) {
+        case ExpressionKind::kNumber:
+            return arena->New<Number>(cast<Number>(expression)->Value);
+        case ExpressionKind::kVariable:
+            return arena->New<Variable>(cast<Variable>(expression)->Name);
+        case ExpressionKind::kBinaryOp: {
+            const auto* bin_op = cast<BinaryOp>(expression);
+            return arena->New<BinaryOp>(bin_op->Op,
+                                        Clone(bin_op->LhsOp, arena),
+                                        Clone(bin_op->RhsOp, arena));
+        }
+        case ExpressionKind::kFnCall: {
+            const auto* fn_call = cast<FnCall>(expression);
+            std::vector<const BaseExpression*> args;
+            args.reserve(fn_call->Args.size());
+            for (const BaseExpression* arg : fn_call->Args) {
+                args.push_back(Clone(arg, arena));
+            }
+            return arena->New<FnCall>(fn_call->Callee, arena->CopyArray(args));
+        }
+        case ExpressionKind::kFnPrototype:
+            return CloneFnPrototype(cast<FnPrototype>(expression), arena);
+        case ExpressionKind::kFn: {
+            const auto* fn = cast<Fn>(expression);
+            return arena->New<Fn>(CloneFnPrototype(fn->Proto, arena),
+                                  Clone(fn->Body, arena));
+        }
+    }
+    return nullptr;
+}
+}  // namespace kaleidoscope::ast
@@ -4,8 +4,8 @@
 
 namespace kaleidoscope::ast
 {
-Fn::Fn(std::unique_ptr<FnPrototype> proto, std::unique_ptr<BaseExpression> body)
-    : Proto(std::move(proto)), Body(std::move(body))
+Fn::Fn(const FnPrototype* proto, const BaseExpression* body)
+    : BaseExpression(kKind), Proto(proto), Body(body)
 {
 }
 
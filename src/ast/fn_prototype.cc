@@ -3,11 +3,13 @@
 #include <fmt/core.h>
 #include <fmt/ranges.h>
 
+#include <string_view>
+#include <vector>
+
 namespace kaleidoscope::ast
 {
-FnPrototype::FnPrototype(const std::string_view& name,
-                         std::vector<std::string_view> args)
-    : Name(name), Args(std::move(args))
+FnPrototype::FnPrototype(Symbol name, Span<const Symbol> args)
+    : BaseExpression(kKind), Name(name), Args(args)
 {
 }
 
@@ -15,8 +17,10 @@ void FnPrototype::PrintToString(std::string& out_str, size_t indent_level,
                                 char space_char, size_t indent_size) const
 {
     out_str += fmt::format("{: >{}}", "", indent_level * indent_size);
-    out_str +=
-        fmt::format("proto= name={} args={}\n", Name, fmt::join(Args, ", "));
+    std::vector<std::string_view> arg_names;
+    for (Symbol arg : Args) arg_names.push_back(arg.GetSpelling());
+    out_str += fmt::format("proto= name={} args={}\n", Name.GetSpelling(),
+                           fmt::join(arg_names, ", "));
 }
 
 }  // namespace kaleidoscope::ast
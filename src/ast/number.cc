@@ -4,7 +4,7 @@
 
 namespace kaleidoscope::ast
 {
-Number::Number(double value) : Value(value) {}
+Number::Number(double value) : BaseExpression(kKind), Value(value) {}
 
 void Number::PrintToString(std::string& out_str, size_t indent_level,
                            char space_char, size_t indent_size) const
@@ -4,13 +4,13 @@
 
 namespace kaleidoscope::ast
 {
-Variable::Variable(std::string_view name) : Name(name) {}
+Variable::Variable(Symbol name) : BaseExpression(kKind), Name(name) {}
 
 void Variable::PrintToString(std::string& out_str, size_t indent_level,
                              char space_char, size_t indent_size) const
 {
     out_str += fmt::format("{: >{}}", "", indent_level * indent_size);
-    out_str += fmt::format("var={}\n", Name);
+    out_str += fmt::format("var={}\n", Name.GetSpelling());
 }
 
 }  // namespace kaleidoscope::ast
@@ -0,0 +1,212 @@
+#include "kaleidoscope/bytecode.h"
+
+#include "kaleidoscope/ast/binary_op.h"
+#include "kaleidoscope/ast/fn_call.h"
+#include "kaleidoscope/ast/number.h"
+#include "kaleidoscope/ast/variable.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <unordered_map>
+
+namespace kaleidoscope::bytecode
+{
+namespace
+{
+// Registers are handed out as a stack: the value of an expression lands in
+// the lowest free register, and everything above it is free again once it
+// has been computed.
+class FunctionCompiler
+{
+   public:
+    FunctionCompiler(ast::Span<const Symbol> params,
+                     const FunctionIndices& indices,
+                     const std::vector<Function>& functions, Function* out)
+        : params_(params),
+          indices_(indices),
+          functions_(functions),
+          out_(out),
+          next_register_(params.size())
+    {
+    }
+
+    bool Compile(const ast::BaseExpression* body)
+    {
+        out_->Code.clear();
+        out_->Constants.clear();
+        out_->RegisterCount = params_.size();
+        if (params_.size() > kMaxRegisters) {
+            std::cerr << "Too many parameters\n";
+            return false;
+        }
+        const std::optional<uint32_t> result = CompileExpression(body);
+        if (!result) return false;
+        Emit(Opcode::kReturn, *result);
+        return true;
+    }
+
+   private:
+    std::optional<uint32_t> CompileExpression(
+        const ast::BaseExpression* expression)
+    {
+        switch (expression->GetKind()) {
+            case ast::ExpressionKind::kNumber:
+                return CompileNumber(ast::cast<ast::Number>(expression));
+            case ast::ExpressionKind::kVariable:
+                return CompileVariable(ast::cast<ast::Variable>(expression));
+            case ast::ExpressionKind::kBinaryOp:
+                return CompileBinaryOp(ast::cast<ast::BinaryOp>(expression));
+            case ast::ExpressionKind::kFnCall:
+                return CompileFnCall(ast::cast<ast::FnCall>(expression));
+            case ast::ExpressionKind::kFnPrototype:
+            case ast::ExpressionKind::kFn:
+                break;
+        }
+        return std::nullopt;
+    }
+
+    std::optional<uint32_t> CompileNumber(const ast::Number* number)
+    {
+        // Keyed by bit pattern, so that 0 and -0 stay apart.
+        uint64_t bits;
+        std::memcpy(&bits, &number->Value, sizeof(bits));
+        auto [it, inserted] = constant_indices_.try_emplace(
+            bits, static_cast<uint32_t>(out_->Constants.size()));
+        if (inserted) out_->Constants.push_back(number->Value);
+
+        const std::optional<uint32_t> target = AllocateRegister();
+        if (!target) return std::nullopt;
+        EmitWide(Opcode::kLoadConstant, *target, it->second);
+        return target;
+    }
+
+    std::optional<uint32_t> CompileVariable(const ast::Variable* variable)
+    {
+        // Parameters already live in their registers.
+        for (size_t i = 0; i < params_.size(); ++i) {
+            if (params_[i] == variable->Name) return static_cast<uint32_t>(i);
+        }
+        std::cerr << "Unknown variable name\n";
+        return std::nullopt;
+    }
+
+    std::optional<uint32_t> CompileBinaryOp(const ast::BinaryOp* bin_op)
+    {
+        Opcode op;
+        switch (bin_op->Op) {
+            case '+':
+                op = Opcode::kAdd;
+                break;
+            case '-':
+                op = Opcode::kSub;
+                break;
+            case '*':
+                op = Opcode::kMul;
+                break;
+            default:
+                return std::nullopt;
+        }
+
+        const size_t first_free = next_register_;
+        const std::optional<uint32_t> lhs = CompileExpression(bin_op->LhsOp);
+        if (!lhs) return std::nullopt;
+        const std::optional<uint32_t> rhs = CompileExpression(bin_op->RhsOp);
+        if (!rhs) return std::nullopt;
+        // Operands are read before the result is written, so it can reuse
+        // their temporaries.
+        next_register_ = first_free;
+        const std::optional<uint32_t> target = AllocateRegister();
+        if (!target) return std::nullopt;
+        Emit(op, *target, *lhs, *rhs);
+        return target;
+    }
+
+    std::optional<uint32_t> CompileFnCall(const ast::FnCall* fn_call)
+    {
+        const uint32_t* callee = indices_.Find(fn_call->Callee);
+        if (!callee) {
+            std::cerr << "Unknown function referenced\n";
+            return std::nullopt;
+        }
+        if (functions_[*callee].Arity != fn_call->Args.size()) {
+            std::cerr << "Incorrect # arguments passed\n";
+            return std::nullopt;
+        }
+
+        // Arguments go to consecutive registers, which become the
+        // parameters of the callee's frame. The result replaces the first.
+        const auto base = static_cast<uint32_t>(next_register_);
+        const size_t arg_count = fn_call->Args.size();
+        for (size_t i = 0; i < std::max<size_t>(arg_count, 1); ++i) {
+            if (!AllocateRegister()) return std::nullopt;
+        }
+        for (size_t i = 0; i < arg_count; ++i) {
+            const auto arg_register = static_cast<uint32_t>(base + i);
+            next_register_ = arg_register;
+            const std::optional<uint32_t> value =
+                CompileExpression(fn_call->Args[i]);
+            if (!value) return std::nullopt;
+            if (*value != arg_register) {
+                Emit(Opcode::kMove, arg_register, *value);
+            }
+            next_register_ = arg_register + 1;
+        }
+        next_register_ = base + 1;
+        EmitWide(Opcode::kCall, base, *callee);
+        return base;
+    }
+
+    std::optional<uint32_t> AllocateRegister()
+    {
+        if (next_register_ == kMaxRegisters) {
+            std::cerr << "Expression needs too many registers\n";
+            return std::nullopt;
+        }
+        const auto allocated = static_cast<uint32_t>(next_register_++);
+        out_->RegisterCount = std::max(out_->RegisterCount, next_register_);
+        return allocated;
+    }
+
+    void Emit(Opcode op, uint32_t a, uint32_t b = 0, uint32_t c = 0)
+    {
+        out_->Code.push_back({op, static_cast<uint16_t>(a),
+                              static_cast<uint16_t>(b),
+                              static_cast<uint16_t>(c)});
+    }
+
+    void EmitWide(Opcode op, uint32_t a, uint32_t index)
+    {
+        Emit(op, a, index & UINT16_MAX, index >> 16);
+    }
+
+    ast::Span<const Symbol> params_;
+    const FunctionIndices& indices_;
+    const std::vector<Function>& functions_;
+    Function* out_;
+    size_t next_register_;
+    std::unordered_map<uint64_t, uint32_t> constant_indices_;
+};
+}  // namespace
+
+bool CompileFunction(ast::Span<const Symbol> params,
+                     const ast::BaseExpression* body,
+                     const FunctionIndices& indices,
+                     const std::vector<Function>& functions, Function* out)
+{
+    FunctionCompiler compiler(params, indices, functions, out);
+    return compiler.Compile(body);
+}
+
+std::vector<uint32_t> GetCallees(const Function& function)
+{
+    std::vector<uint32_t> callees;
+    for (const Instruction& instruction : function.Code) {
+        if (instruction.Op == Opcode::kCall) {
+            callees.push_back(instruction.B | uint32_t{instruction.C} << 16);
+        }
+    }
+    return callees;
+}
+}  // namespace kaleidoscope::bytecode
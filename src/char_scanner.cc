@@ -0,0 +1,181 @@
+#include "kaleidoscope/char_scanner.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define KALEIDOSCOPE_SCANNER_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+// AVX2 kernels are built with a target attribute and only called once the
+// CPU has been checked, so the rest of the binary keeps the baseline ISA.
+#define KALEIDOSCOPE_SCANNER_AVX2
+#define KALEIDOSCOPE_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+namespace kaleidoscope
+{
+namespace scanner
+{
+
+namespace
+{
+template <uint8_t CharClass>
+const char* SkipScalar(const char* begin, const char* end)
+{
+    while (begin != end &&
+           IsInClass(static_cast<unsigned char>(*begin), CharClass)) {
+        ++begin;
+    }
+    return begin;
+}
+
+const Kernels kScalarKernels{"scalar", SkipScalar<kSpace>,
+                             SkipScalar<kAlpha | kDigit>, SkipScalar<kDigit>};
+
+#if defined(KALEIDOSCOPE_SCANNER_SSE2)
+unsigned CountTrailingZeros(uint32_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// The comparisons below are signed, bytes above 0x7f are negative and never
+// fall in any of the ASCII ranges.
+__m128i InRangeSse2(__m128i chars, char low, char high)
+{
+    return _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8(low - 1)),
+                         _mm_cmpgt_epi8(_mm_set1_epi8(high + 1), chars));
+}
+
+struct WhitespaceSse2 {
+    static __m128i Match(__m128i chars)
+    {
+        return _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8(' ')),
+                            InRangeSse2(chars, '\t', '\r'));
+    }
+};
+
+struct AlphaNumericSse2 {
+    static __m128i Match(__m128i chars)
+    {
+        const __m128i lower = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+        return _mm_or_si128(InRangeSse2(chars, '0', '9'),
+                            InRangeSse2(lower, 'a', 'z'));
+    }
+};
+
+struct DigitSse2 {
+    static __m128i Match(__m128i chars)
+    {
+        return InRangeSse2(chars, '0', '9');
+    }
+};
+
+template <typename Matcher, uint8_t CharClass>
+const char* SkipSse2(const char* begin, const char* end)
+{
+    while (end - begin >= 16) {
+        const __m128i chars =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        const uint32_t mismatches =
+            ~static_cast<uint32_t>(_mm_movemask_epi8(Matcher::Match(chars))) &
+            0xffff;
+        if (mismatches != 0) return begin + CountTrailingZeros(mismatches);
+        begin += 16;
+    }
+    return SkipScalar<CharClass>(begin, end);
+}
+
+const Kernels kSse2Kernels{"sse2", SkipSse2<WhitespaceSse2, kSpace>,
+                           SkipSse2<AlphaNumericSse2, kAlpha | kDigit>,
+                           SkipSse2<DigitSse2, kDigit>};
+#endif  // KALEIDOSCOPE_SCANNER_SSE2
+
+#if defined(KALEIDOSCOPE_SCANNER_AVX2)
+KALEIDOSCOPE_TARGET_AVX2 __m256i InRangeAvx2(__m256i chars, char low,
+                                             char high)
+{
+    return _mm256_and_si256(
+        _mm256_cmpgt_epi8(chars, _mm256_set1_epi8(low - 1)),
+        _mm256_cmpgt_epi8(_mm256_set1_epi8(high + 1), chars));
+}
+
+struct WhitespaceAvx2 {
+    KALEIDOSCOPE_TARGET_AVX2 static __m256i Match(__m256i chars)
+    {
+        const __m256i space = _mm256_set1_epi8(' ');
+        return _mm256_or_si256(_mm256_cmpeq_epi8(chars, space),
+                               InRangeAvx2(chars, '\t', '\r'));
+    }
+};
+
+struct AlphaNumericAvx2 {
+    KALEIDOSCOPE_TARGET_AVX2 static __m256i Match(__m256i chars)
+    {
+        const __m256i lower = _mm256_or_si256(chars, _mm256_set1_epi8(0x20));
+        return _mm256_or_si256(InRangeAvx2(chars, '0', '9'),
+                               InRangeAvx2(lower, 'a', 'z'));
+    }
+};
+
+struct DigitAvx2 {
+    KALEIDOSCOPE_TARGET_AVX2 static __m256i Match(__m256i chars)
+    {
+        return InRangeAvx2(chars, '0', '9');
+    }
+};
+
+template <typename Matcher, typename TailMatcher, uint8_t CharClass>
+KALEIDOSCOPE_TARGET_AVX2 const char* SkipAvx2(const char* begin,
+                                              const char* end)
+{
+    while (end - begin >= 32) {
+        const __m256i chars =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+        const uint32_t mismatches = ~static_cast<uint32_t>(
+            _mm256_movemask_epi8(Matcher::Match(chars)));
+        if (mismatches != 0) return begin + CountTrailingZeros(mismatches);
+        begin += 32;
+    }
+    return SkipSse2<TailMatcher, CharClass>(begin, end);
+}
+
+const Kernels kAvx2Kernels{
+    "avx2", SkipAvx2<WhitespaceAvx2, WhitespaceSse2, kSpace>,
+    SkipAvx2<AlphaNumericAvx2, AlphaNumericSse2, kAlpha | kDigit>,
+    SkipAvx2<DigitAvx2, DigitSse2, kDigit>};
+
+bool CpuSupportsAvx2() { return __builtin_cpu_supports("avx2"); }
+#endif  // KALEIDOSCOPE_SCANNER_AVX2
+}  // namespace
+
+const Kernels& ScalarKernels() { return kScalarKernels; }
+
+const Kernels& SelectedKernels()
+{
+    static const Kernels& selected = *SupportedKernels().back();
+    return selected;
+}
+
+std::vector<const Kernels*> SupportedKernels()
+{
+    std::vector<const Kernels*> kernels = {&kScalarKernels};
+#if defined(KALEIDOSCOPE_SCANNER_SSE2)
+    kernels.push_back(&kSse2Kernels);
+#endif
+#if defined(KALEIDOSCOPE_SCANNER_AVX2)
+    if (CpuSupportsAvx2()) kernels.push_back(&kAvx2Kernels);
+#endif
+    return kernels;
+}
+
+}  // namespace scanner
+}  // namespace kaleidoscope
@@ -0,0 +1,38 @@
+#include "kaleidoscope/diagnostic.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+
+namespace kaleidoscope
+{
+void LocateDiagnostics(std::string_view source,
+                       std::vector<Diagnostic>* diagnostics, size_t first)
+{
+    // Lines are counted from the previous diagnostic on, so the source is
+    // read once however many there are.
+    size_t scanned = 0;
+    size_t line = 1;
+    size_t line_start = 0;
+    for (size_t i = first; i < diagnostics->size(); ++i) {
+        Diagnostic& diagnostic = (*diagnostics)[i];
+        const size_t offset = std::min(diagnostic.Offset, source.size());
+        for (size_t pos = source.find('\n', scanned); pos < offset;
+             pos = source.find('\n', pos + 1)) {
+            ++line;
+            line_start = pos + 1;
+        }
+        scanned = std::max(scanned, offset);
+        diagnostic.Line = line;
+        diagnostic.Column = offset - line_start + 1;
+    }
+}
+
+std::string FormatDiagnostic(const Diagnostic& diagnostic)
+{
+    return fmt::format(
+        "{}:{}: {}: {} [{}]", diagnostic.Line, diagnostic.Column,
+        diagnostic.Severity == DiagnosticSeverity::kNote ? "note" : "error",
+        diagnostic.Message, DiagnosticCodeToString(diagnostic.Code));
+}
+}  // namespace kaleidoscope
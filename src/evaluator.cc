@@ -0,0 +1,73 @@
+#include "kaleidoscope/evaluator.h"
+
+#include "kaleidoscope/ast/binary_op.h"
+#include "kaleidoscope/ast/fn_call.h"
+#include "kaleidoscope/ast/number.h"
+#include "kaleidoscope/ast/variable.h"
+
+#include <llvm/ADT/SmallVector.h>
+
+#include <iostream>
+
+namespace kaleidoscope
+{
+
+namespace evaluator
+{
+std::optional<double> Evaluate(const ast::BaseExpression* expression,
+                               ast::Span<const Symbol> params,
+                               ast::Span<const double> args,
+                               CallHandler* calls)
+{
+    switch (expression->GetKind()) {
+        case ast::ExpressionKind::kNumber:
+            return ast::cast<ast::Number>(expression)->Value;
+        case ast::ExpressionKind::kVariable: {
+            const Symbol name = ast::cast<ast::Variable>(expression)->Name;
+            for (size_t i = 0; i < params.size(); ++i) {
+                if (params[i] == name) return args[i];
+            }
+            std::cerr << "Unknown variable name\n";
+            return std::nullopt;
+        }
+        case ast::ExpressionKind::kBinaryOp: {
+            const auto* bin_op = ast::cast<ast::BinaryOp>(expression);
+            const std::optional<double> lhs =
+                Evaluate(bin_op->LhsOp, params, args, calls);
+            if (!lhs) return std::nullopt;
+            const std::optional<double> rhs =
+                Evaluate(bin_op->RhsOp, params, args, calls);
+            if (!rhs) return std::nullopt;
+            switch (bin_op->Op) {
+                case '+':
+                    return *lhs + *rhs;
+                case '-':
+                    return *lhs - *rhs;
+                case '*':
+                    return *lhs * *rhs;
+                default:
+                    return std::nullopt;
+            }
+        }
+        case ast::ExpressionKind::kFnCall: {
+            const auto* fn_call = ast::cast<ast::FnCall>(expression);
+            llvm::SmallVector<double, 8> values;
+            for (const ast::BaseExpression* arg : fn_call->Args) {
+                const std::optional<double> value =
+                    Evaluate(arg, params, args, calls);
+                if (!value) return std::nullopt;
+                values.push_back(*value);
+            }
+            return calls->Call(
+                fn_call->Callee,
+                ast::Span<const double>(values.data(), values.size()));
+        }
+        case ast::ExpressionKind::kFnPrototype:
+        case ast::ExpressionKind::kFn:
+            // Not expressions, the interpreter registers them.
+            break;
+    }
+    return std::nullopt;
+}
+}  // namespace evaluator
+}  // namespace kaleidoscope
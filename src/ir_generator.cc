@@ -0,0 +1,613 @@
+#include "kaleidoscope/ir_generator.h"
+
+#include "kaleidoscope/ast/base_expression.h"
+#include "kaleidoscope/ast/binary_op.h"
+#include "kaleidoscope/ast/fn_call.h"
+#include "kaleidoscope/ast/fn_prototype.h"
+#include "kaleidoscope/ast/number.h"
+#include "kaleidoscope/ast/variable.h"
+
+#include <llvm/ADT/APFloat.h>
+#include <llvm/IR/Constant.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+namespace kaleidoscope
+{
+
+namespace
+{
+// The cache header fills a cache line, so slots never share one with the
+// counters.
+constexpr size_t kMemoHeaderWords = 8;
+// Neighbouring slots a key may land in. A key that finds them all taken
+// evicts the first one.
+constexpr size_t kMemoProbes = 4;
+
+llvm::Function* GeneratePrototype(std::string_view name, size_t arity,
+                                  llvm::LLVMContext& context,
+                                  llvm::Module* module)
+{
+    std::vector<llvm::Type*> prot_args(arity, llvm::Type::getDoubleTy(context));
+    llvm::FunctionType* fn_type = llvm::FunctionType::get(
+        llvm::Type::getDoubleTy(context), prot_args, false);
+
+    return llvm::Function::Create(fn_type, llvm::Function::ExternalLinkage,
+                                  name, module);
+}
+
+llvm::FastMathFlags ToLlvmFlags(const FastMathFlags& flags)
+{
+    llvm::FastMathFlags llvm_flags;
+    llvm_flags.setAllowContract(flags.Contract);
+    llvm_flags.setAllowReassoc(flags.Reassoc);
+    llvm_flags.setNoNaNs(flags.NoNaNs);
+    llvm_flags.setNoInfs(flags.NoInfs);
+    return llvm_flags;
+}
+
+llvm::Function* GeneratePrototype(const ast::FnPrototype* p,
+                                  llvm::LLVMContext& context,
+                                  llvm::Module* module)
+{
+    llvm::Function* fn = GeneratePrototype(p->Name.GetSpelling(),
+                                           p->Args.size(), context, module);
+
+    // Set names for all arguments.
+    unsigned aux = 0;
+    for (auto& Arg : fn->args()) Arg.setName(p->Args[aux++].GetSpelling());
+
+    return fn;
+}
+}  // namespace
+
+IRGenerator::IRGenerator(const llvm::DataLayout& data_layout,
+                         const FunctionArities& known_functions,
+                         const MemoizationPolicy* memoization,
+                         const FastMathPolicy* fast_math)
+    : data_layout_(data_layout),
+      known_functions_(known_functions),
+      memoization_(memoization),
+      fast_math_(fast_math)
+{
+    InitializeModule();
+}
+
+IRGenerator::~IRGenerator() = default;
+
+llvm::FastMathFlags IRGenerator::GetFastMathFlags(Symbol function) const
+{
+    if (!fast_math_) return llvm::FastMathFlags();
+    const FastMathFlags* flags = fast_math_->Functions.Find(function);
+    return ToLlvmFlags(flags ? *flags : fast_math_->Default);
+}
+
+void IRGenerator::InitializeModule()
+{
+    // The module and builder must not outlive the context they belong to.
+    ir_builder_.reset();
+    module_.reset();
+
+    functions_ = SymbolMap<llvm::Function*>();
+    context_ = std::make_unique<llvm::LLVMContext>();
+    module_ = std::make_unique<llvm::Module>("JIT Interpreter", *context_);
+    module_->setDataLayout(data_layout_);
+    ir_builder_ = std::make_unique<llvm::IRBuilder<>>(*context_);
+}
+
+llvm::orc::ThreadSafeModule IRGenerator::TakeModule(
+    const std::string& module_name)
+{
+    ir_builder_.reset();
+    module_->setModuleIdentifier(module_name);
+    llvm::orc::ThreadSafeModule module(std::move(module_), std::move(context_));
+    InitializeModule();
+    return module;
+}
+
+llvm::Function* IRGenerator::GetFunction(Symbol name)
+{
+    // First, see if the function has already been added to the current
+    // module.
+    if (llvm::Function* const* fn = functions_.Find(name)) return *fn;
+
+    // If not, check whether we can codegen the declaration from some
+    // existing prototype.
+    const size_t* arity = known_functions_.Find(name);
+    if (!arity) return nullptr;
+
+    llvm::Function* fn = GeneratePrototype(name.GetSpelling(), *arity,
+                                           *context_, module_.get());
+    functions_.Set(name, fn);
+    return fn;
+}
+
+llvm::Function* IRGenerator::GenerateFunction(const ast::FnPrototype* proto,
+                                              const ast::BaseExpression* body)
+{
+    // Earlier functions of the module may have declared it already.
+    llvm::Function* fn = nullptr;
+    if (llvm::Function* const* declared = functions_.Find(proto->Name)) {
+        fn = *declared;
+        if (!fn->empty()) {
+            std::cerr << "Function cannot be redefined\n";
+            return nullptr;
+        }
+        unsigned aux = 0;
+        for (auto& arg : fn->args()) {
+            arg.setName(proto->Args[aux++].GetSpelling());
+        }
+    } else {
+        fn = GeneratePrototype(proto, *context_, module_.get());
+        functions_.Set(proto->Name, fn);
+    }
+
+    const bool memoized =
+        memoization_ && memoization_->Functions.Contains(proto->Name);
+    llvm::Function* body_fn = fn;
+    if (memoized) {
+        std::string impl_name(proto->Name.GetSpelling());
+        impl_name += ".impl";
+        body_fn = llvm::Function::Create(fn->getFunctionType(),
+                                         llvm::Function::InternalLinkage,
+                                         impl_name, module_.get());
+        unsigned aux = 0;
+        for (auto& arg : body_fn->args()) {
+            arg.setName(proto->Args[aux++].GetSpelling());
+        }
+    }
+
+    llvm::BasicBlock* block =
+        llvm::BasicBlock::Create(*context_, "entry", body_fn);
+    ir_builder_->SetInsertPoint(block);
+    // Only the body's arithmetic, and the calls in it, get the flags.
+    llvm::IRBuilderBase::FastMathFlagGuard fast_math_guard(*ir_builder_);
+    ir_builder_->setFastMathFlags(GetFastMathFlags(proto->Name));
+
+    named_values.clear();
+    unsigned aux = 0;
+    for (auto& arg : body_fn->args()) {
+        named_values.emplace_back(proto->Args[aux++], &arg);
+    }
+
+    if (llvm::Value* ret_val = GenerateIR(body)) {
+        ir_builder_->CreateRet(ret_val);
+        if (!llvm::verifyFunction(*body_fn, &llvm::errs())) {
+            if (memoized) GenerateMemoizedEntry(fn, body_fn);
+            return fn;
+        }
+    }
+
+    // Error generating the body, remove the function. Keep it as a
+    // declaration if other functions of the module already call it.
+    if (memoized) body_fn->eraseFromParent();
+    failed_functions_.emplace_back(proto->Name.GetSpelling());
+    if (fn->use_empty()) {
+        functions_.Erase(proto->Name);
+        fn->eraseFromParent();
+    } else {
+        fn->deleteBody();
+    }
+    return nullptr;
+}
+
+llvm::Function* IRGenerator::GenerateInlineCopy(const ast::FnPrototype* proto,
+                                                const ast::BaseExpression* body)
+{
+    // The module's own definitions, good or broken, take precedence.
+    const std::string_view name = proto->Name.GetSpelling();
+    if (llvm::Function* const* fn = functions_.Find(proto->Name);
+        fn && !(*fn)->isDeclaration()) {
+        return nullptr;
+    }
+    if (std::find(failed_functions_.begin(), failed_functions_.end(), name) !=
+        failed_functions_.end()) {
+        return nullptr;
+    }
+
+    llvm::Function* fn = GenerateFunction(proto, body);
+    if (!fn) {
+        // Calls keep going to the original, which is not this module's
+        // concern.
+        failed_functions_.pop_back();
+        return nullptr;
+    }
+    fn->setLinkage(llvm::GlobalValue::AvailableExternallyLinkage);
+    fn->addFnAttr(llvm::Attribute::AlwaysInline);
+    return fn;
+}
+
+llvm::Function* IRGenerator::GenerateArrayEntry(Symbol callee)
+{
+    llvm::Function* callee_fn = GetFunction(callee);
+    if (!callee_fn) {
+        std::cerr << "Unknown function referenced\n";
+        return nullptr;
+    }
+
+    llvm::Type* double_type = llvm::Type::getDoubleTy(*context_);
+    llvm::FunctionType* entry_type = llvm::FunctionType::get(
+        double_type, {llvm::PointerType::getUnqual(double_type)}, false);
+    llvm::Function* entry = llvm::Function::Create(
+        entry_type, llvm::Function::ExternalLinkage,
+        GetArrayEntryName(callee.GetSpelling()), module_.get());
+    ir_builder_->SetInsertPoint(
+        llvm::BasicBlock::Create(*context_, "entry", entry));
+
+    llvm::Argument* args = entry->getArg(0);
+    args->setName("args");
+    std::vector<llvm::Value*> call_args;
+    for (unsigned i = 0; i < callee_fn->arg_size(); ++i) {
+        llvm::Value* address =
+            ir_builder_->CreateConstInBoundsGEP1_64(double_type, args, i);
+        call_args.push_back(ir_builder_->CreateLoad(double_type, address));
+    }
+    ir_builder_->CreateRet(
+        ir_builder_->CreateCall(callee_fn, call_args, "calltmp"));
+    return entry;
+}
+
+std::string IRGenerator::GetArrayEntryName(std::string_view function_name)
+{
+    // Identifiers never contain dots, so this cannot clash with a function.
+    std::string name(function_name);
+    name += ".entry";
+    return name;
+}
+
+llvm::Function* IRGenerator::GenerateBatchEntry(Symbol callee)
+{
+    llvm::Function* callee_fn = GetFunction(callee);
+    if (!callee_fn) {
+        std::cerr << "Unknown function referenced\n";
+        return nullptr;
+    }
+
+    llvm::Type* double_type = llvm::Type::getDoubleTy(*context_);
+    llvm::Type* double_ptr_type = llvm::PointerType::getUnqual(double_type);
+    llvm::Type* index_type = llvm::Type::getInt64Ty(*context_);
+    llvm::FunctionType* entry_type = llvm::FunctionType::get(
+        llvm::Type::getVoidTy(*context_),
+        {llvm::PointerType::getUnqual(double_ptr_type), double_ptr_type,
+         index_type},
+        false);
+    llvm::Function* entry = llvm::Function::Create(
+        entry_type, llvm::Function::ExternalLinkage,
+        GetBatchEntryName(callee.GetSpelling()), module_.get());
+    llvm::Argument* columns = entry->getArg(0);
+    columns->setName("columns");
+    columns->addAttr(llvm::Attribute::ReadOnly);
+    llvm::Argument* out = entry->getArg(1);
+    out->setName("out");
+    out->addAttr(llvm::Attribute::NoAlias);
+    llvm::Argument* rows = entry->getArg(2);
+    rows->setName("rows");
+
+    llvm::BasicBlock* entry_block =
+        llvm::BasicBlock::Create(*context_, "entry", entry);
+    llvm::BasicBlock* loop_block =
+        llvm::BasicBlock::Create(*context_, "loop", entry);
+    llvm::BasicBlock* exit_block =
+        llvm::BasicBlock::Create(*context_, "exit", entry);
+
+    ir_builder_->SetInsertPoint(entry_block);
+    std::vector<llvm::Value*> column_data;
+    for (unsigned i = 0; i < callee_fn->arg_size(); ++i) {
+        llvm::Value* address = ir_builder_->CreateConstInBoundsGEP1_64(
+            double_ptr_type, columns, i);
+        column_data.push_back(
+            ir_builder_->CreateLoad(double_ptr_type, address, "column"));
+    }
+    llvm::Value* zero = llvm::ConstantInt::get(index_type, 0);
+    ir_builder_->CreateCondBr(ir_builder_->CreateICmpEQ(rows, zero),
+                              exit_block, loop_block);
+
+    ir_builder_->SetInsertPoint(loop_block);
+    llvm::PHINode* row = ir_builder_->CreatePHI(index_type, 2, "row");
+    row->addIncoming(zero, entry_block);
+    std::vector<llvm::Value*> call_args;
+    for (llvm::Value* data : column_data) {
+        llvm::Value* address =
+            ir_builder_->CreateInBoundsGEP(double_type, data, row);
+        call_args.push_back(ir_builder_->CreateLoad(double_type, address));
+    }
+    ir_builder_->CreateStore(
+        ir_builder_->CreateCall(callee_fn, call_args, "calltmp"),
+        ir_builder_->CreateInBoundsGEP(double_type, out, row));
+    llvm::Value* next_row = ir_builder_->CreateNUWAdd(
+        row, llvm::ConstantInt::get(index_type, 1), "nextrow");
+    row->addIncoming(next_row, loop_block);
+    ir_builder_->CreateCondBr(ir_builder_->CreateICmpEQ(next_row, rows),
+                              exit_block, loop_block);
+
+    ir_builder_->SetInsertPoint(exit_block);
+    ir_builder_->CreateRetVoid();
+    return entry;
+}
+
+std::string IRGenerator::GetBatchEntryName(std::string_view function_name)
+{
+    std::string name(function_name);
+    name += ".batch";
+    return name;
+}
+
+std::string IRGenerator::GetMemoTableName(std::string_view function_name)
+{
+    std::string name(function_name);
+    name += ".memo";
+    return name;
+}
+
+size_t IRGenerator::GetMemoTableWords(size_t arity, size_t table_size)
+{
+    return kMemoHeaderWords + table_size * (arity + 2);
+}
+
+void IRGenerator::GenerateMemoizedEntry(llvm::Function* fn,
+                                        llvm::Function* impl)
+{
+    llvm::Type* word_type = llvm::Type::getInt64Ty(*context_);
+    const llvm::Align word_align(8);
+    const size_t arity = fn->arg_size();
+    const uint64_t slot_words = arity + 2;
+    llvm::Constant* table = module_->getOrInsertGlobal(
+        GetMemoTableName(fn->getName()), word_type);
+    auto constant = [&](uint64_t value) {
+        return llvm::ConstantInt::get(word_type, value);
+    };
+    auto word_address = [&](llvm::Value* index) {
+        return ir_builder_->CreateInBoundsGEP(word_type, table, index);
+    };
+    auto load = [&](llvm::Value* index, llvm::AtomicOrdering ordering) {
+        llvm::LoadInst* value =
+            ir_builder_->CreateAlignedLoad(word_type, word_address(index),
+                                           word_align);
+        value->setAtomic(ordering);
+        return value;
+    };
+    auto store = [&](llvm::Value* value, llvm::Value* index,
+                     llvm::AtomicOrdering ordering) {
+        ir_builder_->CreateAlignedStore(value, word_address(index), word_align)
+            ->setAtomic(ordering);
+    };
+    auto count = [&](uint64_t counter_word) {
+        llvm::Value* index = constant(counter_word);
+        store(ir_builder_->CreateAdd(
+                  load(index, llvm::AtomicOrdering::Monotonic), constant(1)),
+              index, llvm::AtomicOrdering::Monotonic);
+    };
+
+    // Keys are compared bit for bit, so 0 and -0 are different arguments
+    // and a NaN finds itself.
+    ir_builder_->SetInsertPoint(
+        llvm::BasicBlock::Create(*context_, "entry", fn));
+    std::vector<llvm::Value*> keys;
+    llvm::Value* hash = constant(0x9e3779b97f4a7c15);
+    for (llvm::Argument& arg : fn->args()) {
+        keys.push_back(ir_builder_->CreateBitCast(&arg, word_type));
+        hash = ir_builder_->CreateMul(ir_builder_->CreateXor(hash, keys.back()),
+                                      constant(0xff51afd7ed558ccd));
+        hash = ir_builder_->CreateXor(hash,
+                                      ir_builder_->CreateLShr(hash, 32));
+    }
+    const uint64_t slot_mask = memoization_->TableSize - 1;
+    llvm::Value* home = ir_builder_->CreateAnd(hash, constant(slot_mask));
+
+    llvm::BasicBlock* hit_block =
+        llvm::BasicBlock::Create(*context_, "hit", fn);
+    llvm::BasicBlock* miss_block =
+        llvm::BasicBlock::Create(*context_, "miss", fn);
+    llvm::PHINode* hit_value = llvm::PHINode::Create(
+        word_type, kMemoProbes, "cached", hit_block);
+
+    // Readers take the sequence number before and after the slot, and only
+    // trust it if both are the same even, non-zero number.
+    std::vector<llvm::Value*> slot_bases;
+    std::vector<llvm::Value*> sequences;
+    for (size_t probe = 0; probe < kMemoProbes; ++probe) {
+        llvm::Value* slot = ir_builder_->CreateAnd(
+            ir_builder_->CreateAdd(home, constant(probe)), constant(slot_mask));
+        llvm::Value* base = ir_builder_->CreateAdd(
+            ir_builder_->CreateMul(slot, constant(slot_words)),
+            constant(kMemoHeaderWords));
+        llvm::Value* sequence = load(base, llvm::AtomicOrdering::Acquire);
+        llvm::Value* found = ir_builder_->CreateICmpNE(sequence, constant(0));
+        for (size_t i = 0; i < arity; ++i) {
+            llvm::Value* key =
+                load(ir_builder_->CreateAdd(base, constant(1 + i)),
+                     llvm::AtomicOrdering::Monotonic);
+            found = ir_builder_->CreateAnd(
+                found, ir_builder_->CreateICmpEQ(key, keys[i]));
+        }
+        llvm::Value* value =
+            load(ir_builder_->CreateAdd(base, constant(1 + arity)),
+                 llvm::AtomicOrdering::Monotonic);
+        ir_builder_->CreateFence(llvm::AtomicOrdering::Acquire);
+        llvm::Value* sequence_after =
+            load(base, llvm::AtomicOrdering::Monotonic);
+        found = ir_builder_->CreateAnd(
+            found, ir_builder_->CreateICmpEQ(sequence, sequence_after));
+        found = ir_builder_->CreateAnd(
+            found, ir_builder_->CreateICmpEQ(
+                       ir_builder_->CreateAnd(sequence, constant(1)),
+                       constant(0)));
+
+        llvm::BasicBlock* next_block =
+            probe + 1 < kMemoProbes
+                ? llvm::BasicBlock::Create(*context_, "probe", fn, hit_block)
+                : miss_block;
+        hit_value->addIncoming(value, ir_builder_->GetInsertBlock());
+        ir_builder_->CreateCondBr(found, hit_block, next_block);
+        ir_builder_->SetInsertPoint(next_block);
+        slot_bases.push_back(base);
+        sequences.push_back(sequence);
+    }
+
+    // Miss: compute the result and store it in the first empty slot, or
+    // in the home slot if there is none. Writers that find the slot taken
+    // by another writer leave it alone.
+    std::vector<llvm::Value*> args;
+    for (llvm::Argument& arg : fn->args()) args.push_back(&arg);
+    llvm::Value* result = ir_builder_->CreateCall(impl, args, "result");
+    count(kMemoMissesWord);
+    llvm::Value* target = slot_bases.front();
+    for (size_t probe = kMemoProbes; probe-- > 0;) {
+        target = ir_builder_->CreateSelect(
+            ir_builder_->CreateICmpEQ(sequences[probe], constant(0)),
+            slot_bases[probe], target);
+    }
+    llvm::Value* sequence = load(target, llvm::AtomicOrdering::Monotonic);
+    llvm::BasicBlock* claim_block =
+        llvm::BasicBlock::Create(*context_, "claim", fn);
+    llvm::BasicBlock* write_block =
+        llvm::BasicBlock::Create(*context_, "write", fn);
+    llvm::BasicBlock* done_block =
+        llvm::BasicBlock::Create(*context_, "done", fn);
+    ir_builder_->CreateCondBr(
+        ir_builder_->CreateICmpEQ(
+            ir_builder_->CreateAnd(sequence, constant(1)), constant(0)),
+        claim_block, done_block);
+
+    ir_builder_->SetInsertPoint(claim_block);
+    llvm::Value* claimed = ir_builder_->CreateAtomicCmpXchg(
+        word_address(target), sequence,
+        ir_builder_->CreateAdd(sequence, constant(1)), word_align,
+        llvm::AtomicOrdering::Monotonic, llvm::AtomicOrdering::Monotonic);
+    ir_builder_->CreateCondBr(ir_builder_->CreateExtractValue(claimed, 1),
+                              write_block, done_block);
+
+    ir_builder_->SetInsertPoint(write_block);
+    ir_builder_->CreateFence(llvm::AtomicOrdering::Release);
+    for (size_t i = 0; i < arity; ++i) {
+        store(keys[i], ir_builder_->CreateAdd(target, constant(1 + i)),
+              llvm::AtomicOrdering::Monotonic);
+    }
+    store(ir_builder_->CreateBitCast(result, word_type),
+          ir_builder_->CreateAdd(target, constant(1 + arity)),
+          llvm::AtomicOrdering::Monotonic);
+    store(ir_builder_->CreateAdd(sequence, constant(2)), target,
+          llvm::AtomicOrdering::Release);
+    ir_builder_->CreateBr(done_block);
+
+    ir_builder_->SetInsertPoint(done_block);
+    ir_builder_->CreateRet(result);
+
+    ir_builder_->SetInsertPoint(hit_block);
+    count(kMemoHitsWord);
+    ir_builder_->CreateRet(
+        ir_builder_->CreateBitCast(hit_value, fn->getReturnType()));
+}
+
+std::vector<std::string> IRGenerator::DropBrokenFunctions(
+    const std::vector<std::string>& broken_elsewhere)
+{
+    std::vector<std::string> dropped;
+    std::vector<std::string> worklist = std::move(failed_functions_);
+    failed_functions_.clear();
+    worklist.insert(worklist.end(), broken_elsewhere.begin(),
+                    broken_elsewhere.end());
+    while (!worklist.empty()) {
+        dropped.push_back(std::move(worklist.back()));
+        worklist.pop_back();
+
+        llvm::Function* fn = module_->getFunction(dropped.back());
+        if (!fn) continue;
+        std::vector<llvm::Function*> callers;
+        for (llvm::User* user : fn->users()) {
+            if (auto* call = llvm::dyn_cast<llvm::CallInst>(user)) {
+                callers.push_back(call->getFunction());
+            }
+        }
+        for (llvm::Function* caller : callers) {
+            if (caller->isDeclaration()) continue;
+            caller->deleteBody();
+            worklist.push_back(caller->getName().str());
+        }
+    }
+    return dropped;
+}
+
+llvm::Value* IRGenerator::GenerateIR(const ast::BaseExpression* expression)
+{
+    switch (expression->GetKind()) {
+        case ast::ExpressionKind::kNumber:
+            return GenerateNumber(ast::cast<ast::Number>(expression));
+        case ast::ExpressionKind::kVariable:
+            return GenerateVariable(ast::cast<ast::Variable>(expression));
+        case ast::ExpressionKind::kBinaryOp:
+            return GenerateBinaryOp(ast::cast<ast::BinaryOp>(expression));
+        case ast::ExpressionKind::kFnCall:
+            return GenerateFnCall(ast::cast<ast::FnCall>(expression));
+        case ast::ExpressionKind::kFnPrototype:
+        case ast::ExpressionKind::kFn:
+            // Not expressions, handled by GenerateFunction.
+            break;
+    }
+    return nullptr;
+}
+
+llvm::Value* IRGenerator::GenerateNumber(const ast::Number* number)
+{
+    return llvm::ConstantFP::get(*context_, llvm::APFloat(number->Value));
+}
+
+llvm::Value* IRGenerator::GenerateVariable(const ast::Variable* variable)
+{
+    // Functions take a handful of arguments, a linear scan is the fastest.
+    for (const auto& [name, value] : named_values) {
+        if (name == variable->Name) return value;
+    }
+    std::cerr << "Unknown variable name\n";
+    return nullptr;
+}
+
+llvm::Value* IRGenerator::GenerateBinaryOp(const ast::BinaryOp* bin_op)
+{
+    auto lhs = GenerateIR(bin_op->LhsOp);
+    auto rhs = GenerateIR(bin_op->RhsOp);
+    if (!lhs || !rhs) {
+        return nullptr;
+    }
+    switch (bin_op->Op) {
+        case '+':
+            return ir_builder_->CreateFAdd(lhs, rhs, "addtmp");
+        case '-':
+            return ir_builder_->CreateFSub(lhs, rhs, "subtmp");
+        case '*':
+            return ir_builder_->CreateFMul(lhs, rhs, "multmp");
+        default:
+            return nullptr;
+    }
+}
+
+llvm::Value* IRGenerator::GenerateFnCall(const ast::FnCall* fn_call)
+{
+    llvm::Function* callee_fn = GetFunction(fn_call->Callee);
+    if (!callee_fn) {
+        std::cerr << "Unknown function referenced\n";
+        return nullptr;
+    }
+    // If argument mismatch error.
+    if (callee_fn->arg_size() != fn_call->Args.size()) {
+        std::cerr << "Incorrect # arguments passed\n";
+        return nullptr;
+    }
+    std::vector<llvm::Value*> args_ir;
+    for (const ast::BaseExpression* arg : fn_call->Args) {
+        llvm::Value* arg_ir = GenerateIR(arg);
+        if (!arg_ir) return nullptr;
+        args_ir.push_back(arg_ir);
+    }
+
+    return ir_builder_->CreateCall(callee_fn, args_ir, "calltmp");
+}
+
+}  // namespace kaleidoscope
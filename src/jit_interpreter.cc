@@ -2,18 +2,35 @@
 
 #include "kaleidoscope/ast/base_expression.h"
 #include "kaleidoscope/ast/binary_op.h"
+#include "kaleidoscope/ast/clone.h"
+#include "kaleidoscope/ast/compilation_unit.h"
+#include "kaleidoscope/ast/fn.h"
 #include "kaleidoscope/ast/fn_call.h"
 #include "kaleidoscope/ast/fn_prototype.h"
-#include "kaleidoscope/ast/number.h"
+#include "kaleidoscope/lexer_impl.h"
+#include "kaleidoscope/optimizer.h"
+#include "kaleidoscope/parser.h"
+#include "kaleidoscope/simplifier.h"
 
-#include <llvm/ADT/APFloat.h>
-#include <llvm/IR/Constant.h>
-#include <llvm/IR/DerivedTypes.h>>
-#include <llvm/Support/raw_ostream.h>
-#include <llvm/IR/Function.h>
-#include <llvm/IR/Value.h>
+#include <fmt/core.h>
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
+#include <llvm/ExecutionEngine/Orc/Core.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/MathExtras.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/Target/TargetMachine.h>
 
+#include <algorithm>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <unordered_set>
 #include <vector>
 
 namespace kaleidoscope
@@ -21,102 +38,1120 @@ namespace kaleidoscope
 
 namespace
 {
-llvm::Function* GeneratePrototype(const ast::FnPrototype* p,
-                                  llvm::LLVMContext& context,
-                                  llvm::Module* module)
+const char* const kAnonymousExpressionName = "__anon_expr";
+const char* const kUnitModuleName = "unit";
+
+llvm::ExitOnError ExitOnJitError("kaleidoscope: ");
+
+// Optimizes and compiles modules to objects, going through the object
+// cache first when there is one. The cache is consulted before optimizing,
+// so a hit skips both the pass pipeline and machine code generation.
+class OptimizingCompiler : public llvm::orc::IRCompileLayer::IRCompiler
 {
-    std::vector<llvm::Type*> prot_args(p->Args.size(),
-                                       llvm::Type::getDoubleTy(context));
-    llvm::FunctionType* fn_type = llvm::FunctionType::get(
-        llvm::Type::getDoubleTy(context), prot_args, false);
+   public:
+    OptimizingCompiler(std::unique_ptr<llvm::TargetMachine> target_machine,
+                       OptimizationLevel level, DiskObjectCache* cache)
+        : IRCompiler(llvm::orc::irManglingOptionsFromTargetOptions(
+              target_machine->Options)),
+          target_machine_(std::move(target_machine)),
+          level_(level),
+          cache_(cache)
+    {
+    }
+
+    llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>> operator()(
+        llvm::Module& module) override
+    {
+        llvm::TimeTraceScope scope("CompileModule",
+                                   module.getModuleIdentifier());
+        // Top-level expressions only run once, never cache them.
+        const bool cacheable =
+            cache_ && module.getModuleIdentifier() != kAnonymousExpressionName;
+        std::string key;
+        if (cacheable) {
+            key = DiskObjectCache::ComputeKey(module, *target_machine_, level_);
+            if (auto object = cache_->Lookup(key)) return object;
+        }
+
+        optimizer::OptimizeModule(module, level_, target_machine_.get());
+        llvm::TimeTraceScope codegen_scope("CodeGen");
+        auto object = llvm::orc::SimpleCompiler(*target_machine_)(module);
+        if (object && !key.empty()) {
+            cache_->Store(key, (*object)->getMemBufferRef());
+        }
+        return object;
+    }
 
-    llvm::Function* fn = llvm::Function::Create(
-        fn_type, llvm::Function::ExternalLinkage, p->Name, module);
+   private:
+    std::unique_ptr<llvm::TargetMachine> target_machine_;
+    OptimizationLevel level_;
+    DiskObjectCache* cache_;
+};
 
-    // Set names for all arguments.
-    unsigned aux = 0;
-    for (auto& Arg : fn->args()) Arg.setName(p->Args[aux++]);
+// Appends the callee of every call in `expression`.
+void CollectCallees(const ast::BaseExpression* expression,
+                    std::vector<Symbol>* callees)
+{
+    if (const auto* bin_op = ast::dyn_cast<ast::BinaryOp>(expression)) {
+        CollectCallees(bin_op->LhsOp, callees);
+        CollectCallees(bin_op->RhsOp, callees);
+    } else if (const auto* fn_call = ast::dyn_cast<ast::FnCall>(expression)) {
+        callees->push_back(fn_call->Callee);
+        for (const ast::BaseExpression* arg : fn_call->Args) {
+            CollectCallees(arg, callees);
+        }
+    }
+}
+
+// Whether `expression` has at most `limit` nodes. Stops counting past it.
+bool HasAtMostNodes(const ast::BaseExpression* expression, size_t* limit)
+{
+    if (*limit == 0) return false;
+    --*limit;
+    if (const auto* bin_op = ast::dyn_cast<ast::BinaryOp>(expression)) {
+        return HasAtMostNodes(bin_op->LhsOp, limit) &&
+               HasAtMostNodes(bin_op->RhsOp, limit);
+    }
+    if (const auto* fn_call = ast::dyn_cast<ast::FnCall>(expression)) {
+        for (const ast::BaseExpression* arg : fn_call->Args) {
+            if (!HasAtMostNodes(arg, limit)) return false;
+        }
+    }
+    return true;
+}
+
+// Adds inline copies of the functions reachable from a module's bodies,
+// see JitInterpreter::AddInlineCopies.
+using InlineCopier = std::function<void(
+    IRGenerator*, const std::vector<const ast::BaseExpression*>& bodies)>;
+
+// Drops the broken functions of every module, then their callers in the
+// other modules, until no module calls a dropped function. Returns the
+// names of all the dropped functions.
+std::vector<std::string> DropBrokenFunctions(
+    const std::vector<std::unique_ptr<IRGenerator>>& generators)
+{
+    std::unordered_set<std::string> dropped;
+    std::vector<std::string> newly_dropped;
+    auto record = [&](std::vector<std::string> names) {
+        for (std::string& name : names) {
+            if (dropped.insert(name).second) {
+                newly_dropped.push_back(std::move(name));
+            }
+        }
+    };
+
+    for (const auto& generator : generators) {
+        record(generator->DropBrokenFunctions());
+    }
+    while (generators.size() > 1 && !newly_dropped.empty()) {
+        const std::vector<std::string> broken = std::move(newly_dropped);
+        newly_dropped.clear();
+        for (const auto& generator : generators) {
+            record(generator->DropBrokenFunctions(broken));
+        }
+    }
+    return std::vector<std::string>(dropped.begin(), dropped.end());
+}
+
+// Landing address of stubs whose body failed to compile, lazily or not.
+// Calls always return a double, so hand back NaN.
+double CompileFailure()
+{
+    std::cerr << "Could not compile function\n";
+    return std::numeric_limits<double>::quiet_NaN();
+}
 
-    return fn;
+std::string GetVersionName(std::string_view name, unsigned version)
+{
+    // Identifiers never contain dots, so this cannot clash with a function.
+    return fmt::format("{}.v{}", name, version);
 }
+
+// Defines the body of a single function, lowering its AST to IR only once
+// the JIT asks for the symbol. The body, and its memo table if it has one,
+// are renamed to `body_name`, which `body_symbol` is the mangled form of.
+class FunctionAstMaterializationUnit : public llvm::orc::MaterializationUnit
+{
+   public:
+    FunctionAstMaterializationUnit(llvm::orc::SymbolStringPtr body_symbol,
+                                   std::string body_name,
+                                   const ast::Fn* definition,
+                                   llvm::orc::IRLayer& layer,
+                                   const llvm::DataLayout& data_layout,
+                                   const FunctionArities& known_functions,
+                                   const MemoizationPolicy* memoization,
+                                   const FastMathPolicy* fast_math,
+                                   InlineCopier inline_copier)
+        : MaterializationUnit(Interface(
+              llvm::orc::SymbolFlagsMap(
+                  {{body_symbol, llvm::JITSymbolFlags::Exported |
+                                     llvm::JITSymbolFlags::Callable}}),
+              nullptr)),
+          body_name_(std::move(body_name)),
+          definition_(definition),
+          layer_(layer),
+          data_layout_(data_layout),
+          known_functions_(known_functions),
+          memoization_(memoization),
+          fast_math_(fast_math),
+          inline_copier_(std::move(inline_copier))
+    {
+    }
+
+    llvm::StringRef getName() const override
+    {
+        return "FunctionAstMaterializationUnit";
+    }
+
+    void materialize(
+        std::unique_ptr<llvm::orc::MaterializationResponsibility> r) override
+    {
+        const std::string name(definition_->Proto->Name.GetSpelling());
+        IRGenerator generator(data_layout_, known_functions_, memoization_,
+                              fast_math_);
+        {
+            llvm::TimeTraceScope scope("GenerateIR", name);
+            if (!generator.GenerateFunction(definition_->Proto,
+                                            definition_->Body)) {
+                r->failMaterialization();
+                return;
+            }
+            if (inline_copier_) {
+                inline_copier_(&generator, {definition_->Body});
+            }
+        }
+        llvm::orc::ThreadSafeModule module = generator.TakeModule(body_name_);
+        if (body_name_ != name) {
+            module.withModuleDo([&](llvm::Module& m) {
+                m.getFunction(name)->setName(body_name_);
+                if (llvm::GlobalVariable* table = m.getNamedGlobal(
+                        IRGenerator::GetMemoTableName(name))) {
+                    table->setName(IRGenerator::GetMemoTableName(body_name_));
+                }
+            });
+        }
+        layer_.emit(std::move(r), std::move(module));
+    }
+
+   private:
+    void discard(const llvm::orc::JITDylib&,
+                 const llvm::orc::SymbolStringPtr&) override
+    {
+    }
+
+    std::string body_name_;
+    const ast::Fn* definition_;
+    llvm::orc::IRLayer& layer_;
+    const llvm::DataLayout& data_layout_;
+    const FunctionArities& known_functions_;
+    const MemoizationPolicy* memoization_;
+    const FastMathPolicy* fast_math_;
+    InlineCopier inline_copier_;
+};
 }  // namespace
 
-JitInterpreter::JitInterpreter()
-    : context_(std::make_unique<llvm::LLVMContext>()),
-      module_(std::make_unique<llvm::Module>("JIT Interpreter", *context_)),
-      ir_builder_(std::make_unique<llvm::IRBuilder<>>(*context_))
+JitInterpreter::JitInterpreter() : JitInterpreter(JitOptions()) {}
+
+JitInterpreter::JitInterpreter(JitOptions options) : options_(options)
 {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+
+    if (!options_.MemoizedFunctions.empty()) {
+        memoization_ = std::make_unique<MemoizationPolicy>();
+        memoization_->TableSize = llvm::PowerOf2Ceil(
+            std::max<size_t>(options_.MemoTableSize, 1));
+        for (const std::string& name : options_.MemoizedFunctions) {
+            memoization_->Functions.Set(symbols_.Intern(name), true);
+        }
+    }
+
+    if (options_.FastMath.Any() || !options_.FunctionFastMath.empty()) {
+        fast_math_ = std::make_unique<FastMathPolicy>();
+        fast_math_->Default = options_.FastMath;
+        for (const auto& [name, flags] : options_.FunctionFastMath) {
+            fast_math_->Functions.Set(symbols_.Intern(name), flags);
+        }
+    }
+
+    if (!options_.ObjectCacheDirectory.empty()) {
+        object_cache_ =
+            std::make_unique<DiskObjectCache>(options_.ObjectCacheDirectory);
+    }
+
+    llvm::orc::JITTargetMachineBuilder target_builder =
+        ExitOnJitError(llvm::orc::JITTargetMachineBuilder::detectHost());
+    if (options_.CompileThreads > 1) {
+        codegen_target_builder_ =
+            std::make_unique<llvm::orc::JITTargetMachineBuilder>(
+                target_builder);
+        codegen_pool_ = std::make_unique<llvm::ThreadPool>(
+            llvm::hardware_concurrency(options_.CompileThreads));
+    }
+
+    jit_ = ExitOnJitError(
+        llvm::orc::LLJITBuilder()
+            .setJITTargetMachineBuilder(std::move(target_builder))
+            .setCompileFunctionCreator(
+                [this](llvm::orc::JITTargetMachineBuilder target_builder)
+                    -> llvm::Expected<std::unique_ptr<
+                        llvm::orc::IRCompileLayer::IRCompiler>> {
+                    auto target_machine = target_builder.createTargetMachine();
+                    if (!target_machine) return target_machine.takeError();
+                    return std::make_unique<OptimizingCompiler>(
+                        std::move(*target_machine), options_.OptLevel,
+                        object_cache_.get());
+                })
+            .create());
+
+    // Resolve externs against the symbols of the host process.
+    llvm::orc::JITDylib& main_dylib = jit_->getMainJITDylib();
+    main_dylib.addGenerator(ExitOnJitError(
+        llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+            jit_->getDataLayout().getGlobalPrefix())));
+
+    if (options_.LazyCompilation || IsRedefinitionEnabled()) {
+        const llvm::Triple& triple = jit_->getTargetTriple();
+        lazy_call_through_ =
+            ExitOnJitError(llvm::orc::createLocalLazyCallThroughManager(
+                triple, jit_->getExecutionSession(),
+                llvm::pointerToJITTargetAddress(&CompileFailure)));
+        stubs_ = llvm::orc::createLocalIndirectStubsManagerBuilder(triple)();
+
+        // Bodies resolve every call through the main dylib stubs, rather
+        // than against each other, so that each one is only compiled when
+        // it is actually reached.
+        impl_dylib_ = &ExitOnJitError(jit_->createJITDylib("<impl>"));
+        impl_dylib_->setLinkOrder(
+            {{&main_dylib, llvm::orc::JITDylibLookupFlags::MatchAllSymbols}},
+            false);
+    }
 }
 
-llvm::Value* JitInterpreter::GenerateIR(const ast::BaseExpression* expression)
+void JitInterpreter::DeclareExtern(const ast::FnPrototype* extern_call)
 {
-    llvm::Value* val = nullptr;
-    if (const ast::Number* number =
-            dynamic_cast<const ast::Number*>(expression)) {
-        return llvm::ConstantFP::get(*context_, llvm::APFloat(number->Value));
+    function_arities_.Set(extern_call->Name, extern_call->Args.size());
+    // Calls from the interpreter resolve it on first use.
+    if (options_.TierUpThreshold > 0 &&
+        !tiered_functions_.Contains(extern_call->Name)) {
+        tiered_functions_.Set(extern_call->Name, TieredFunction());
     }
-    if (const ast::BinaryOp* bin_op =
-            dynamic_cast<const ast::BinaryOp*>(expression)) {
-        auto lhs = GenerateIR(bin_op->LhsOp.get());
-        auto rhs = GenerateIR(bin_op->RhsOp.get());
-        if (!lhs || !rhs) {
-            return nullptr;
+}
+
+bool JitInterpreter::DeclareDefinition(const ast::Fn* definition)
+{
+    const Symbol name = definition->Proto->Name;
+    const size_t arity = definition->Proto->Args.size();
+    if (const size_t* known_arity = function_arities_.Find(name)) {
+        // Callers were compiled against the old arity.
+        if (!IsRedefinitionEnabled() ||
+            !redefinable_functions_.Contains(name)) {
+            std::cerr << "Function " << name.GetSpelling()
+                      << " cannot be redefined\n";
+            return false;
         }
-        switch (bin_op->Op) {
-            case '+':
-                return ir_builder_->CreateFAdd(lhs, rhs, "addtmp");
-            case '-':
-                return ir_builder_->CreateFSub(lhs, rhs, "subtmp");
-            case '*':
-                return ir_builder_->CreateFMul(lhs, rhs, "multmp");
-            default:
-                return nullptr;
+        if (*known_arity != arity) {
+            std::cerr << "Function " << name.GetSpelling()
+                      << " cannot be redefined with another number of "
+                         "arguments\n";
+            return false;
         }
+        return true;
+    }
+    function_arities_.Set(name, arity);
+
+    if (IsRedefinitionEnabled()) {
+        // Calls go through a stub that lands on the current version, which
+        // fails until one compiles.
+        const std::string spelling(name.GetSpelling());
+        ExitOnJitError(stubs_->createStub(
+            spelling, llvm::pointerToJITTargetAddress(&CompileFailure),
+            llvm::JITSymbolFlags::Exported));
+        llvm::orc::SymbolMap stub;
+        stub[jit_->mangleAndIntern(spelling)] = llvm::JITEvaluatedSymbol(
+            stubs_->findStub(spelling, true).getAddress(),
+            llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable);
+        ExitOnJitError(jit_->getMainJITDylib().define(
+            llvm::orc::absoluteSymbols(std::move(stub))));
+        redefinable_functions_.Set(name, RedefinableFunction());
+        return true;
+    }
+
+    if (memoization_ && memoization_->Functions.Contains(name)) {
+        // Only declared again after its previous definition failed to
+        // compile, so nothing refers to the old cache any more.
+        DropMemoTable(name);
+        memo_tables_.Set(name, CreateMemoTable(name.GetSpelling(), arity));
     }
-    if (const ast::FnCall* fn_call =
-            dynamic_cast<const ast::FnCall*>(expression)) {
-        llvm::Function* callee_fn = module_->getFunction(fn_call->Callee);
-        if (!callee_fn) {
-            std::cerr << "Unknown function referenced\n";
-            return nullptr;
+    definitions_.Set(name, ast::cast<ast::Fn>(
+                               ast::Clone(definition, &definition_nodes_)));
+    return true;
+}
+
+void JitInterpreter::AddInlineCopies(
+    IRGenerator* generator,
+    const std::vector<const ast::BaseExpression*>& bodies) const
+{
+    // Redefinitions would leave stale copies behind in their callers.
+    if (options_.InlineThreshold == 0 || IsRedefinitionEnabled()) return;
+
+    std::vector<Symbol> worklist;
+    for (const ast::BaseExpression* body : bodies) {
+        CollectCallees(body, &worklist);
+    }
+    SymbolMap<bool> visited;
+    while (!worklist.empty()) {
+        const Symbol next = worklist.back();
+        worklist.pop_back();
+        if (visited.Contains(next)) continue;
+        visited.Set(next, true);
+
+        // Externs have no definition.
+        const ast::Fn* const* definition = definitions_.Find(next);
+        if (!definition ||
+            (memoization_ && memoization_->Functions.Contains(next))) {
+            continue;
         }
-        // If argument mismatch error.
-        if (callee_fn->arg_size() != fn_call->Args.size()) {
-            std::cerr << "Incorrect # arguments passed\n";
-            return nullptr;
+        size_t budget = options_.InlineThreshold;
+        if (!HasAtMostNodes((*definition)->Body, &budget)) continue;
+        if (generator->GenerateInlineCopy((*definition)->Proto,
+                                          (*definition)->Body)) {
+            // Its own callees can collapse into it as well.
+            CollectCallees((*definition)->Body, &worklist);
         }
-        std::vector<llvm::Value*> args_ir;
-        for (const auto& arg : fn_call->Args) {
-            llvm::Value* arg_ir = GenerateIR(arg.get());
-            if (!arg_ir) return nullptr;
-            args_ir.push_back(arg_ir);
+    }
+}
+
+bool JitInterpreter::IsRedefinitionEnabled() const
+{
+    return options_.AllowRedefinition && options_.TierUpThreshold == 0;
+}
+
+JitInterpreter::MemoTable JitInterpreter::CreateMemoTable(
+    std::string_view body_name, size_t arity)
+{
+    llvm::orc::JITDylib& main_dylib = jit_->getMainJITDylib();
+    MemoTable table;
+    table.Words = std::make_unique<std::atomic<uint64_t>[]>(
+        IRGenerator::GetMemoTableWords(arity, memoization_->TableSize));
+    table.Tracker = main_dylib.createResourceTracker();
+    llvm::orc::SymbolMap symbols;
+    symbols[jit_->mangleAndIntern(IRGenerator::GetMemoTableName(body_name))] =
+        llvm::JITEvaluatedSymbol(
+            llvm::pointerToJITTargetAddress(table.Words.get()),
+            llvm::JITSymbolFlags::Exported);
+    ExitOnJitError(main_dylib.define(
+        llvm::orc::absoluteSymbols(std::move(symbols)), table.Tracker));
+    return table;
+}
+
+void JitInterpreter::DropMemoTable(Symbol name)
+{
+    if (MemoTable* table = memo_tables_.Find(name)) {
+        ExitOnJitError(table->Tracker->remove());
+        memo_tables_.Erase(name);
+    }
+}
+
+bool JitInterpreter::AddDefinitions(
+    const std::vector<const ast::Fn*>& definitions,
+    const std::string& module_name, bool array_entries)
+{
+    // One contiguous chunk of definitions per compile thread, each lowered
+    // into its own module.
+    const size_t chunk_count = std::max<size_t>(
+        1, std::min<size_t>(codegen_pool_ ? options_.CompileThreads : 1,
+                            definitions.size()));
+    auto chunk_begin = [&](size_t chunk) {
+        return definitions.size() * chunk / chunk_count;
+    };
+
+    std::vector<std::unique_ptr<IRGenerator>> generators;
+    for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+        generators.push_back(std::make_unique<IRGenerator>(
+            jit_->getDataLayout(), function_arities_, memoization_.get(),
+            fast_math_.get()));
+    }
+    auto lower_chunk = [&](size_t chunk) {
+        std::vector<const ast::BaseExpression*> bodies;
+        for (size_t i = chunk_begin(chunk); i < chunk_begin(chunk + 1); ++i) {
+            const ast::FnPrototype* proto = definitions[i]->Proto;
+            if (generators[chunk]->GenerateFunction(proto,
+                                                    definitions[i]->Body) &&
+                array_entries) {
+                generators[chunk]->GenerateArrayEntry(proto->Name);
+            }
+            bodies.push_back(definitions[i]->Body);
+        }
+        AddInlineCopies(generators[chunk].get(), bodies);
+    };
+    {
+        llvm::TimeTraceScope scope("GenerateIR", module_name);
+        if (chunk_count == 1) {
+            lower_chunk(0);
+        } else {
+            for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+                codegen_pool_->async(lower_chunk, chunk);
+            }
+            codegen_pool_->wait();
+        }
+        // Functions that failed, or depend on one that did, are forgotten
+        // so they can be defined again.
+        for (const std::string& name : DropBrokenFunctions(generators)) {
+            if (const Symbol symbol = symbols_.Find(name); symbol.IsValid()) {
+                function_arities_.Erase(symbol);
+                definitions_.Erase(symbol);
+            }
+        }
+    }
+
+    llvm::orc::SymbolLookupSet symbols;
+    for (const ast::Fn* definition : definitions) {
+        if (function_arities_.Contains(definition->Proto->Name)) {
+            symbols.add(jit_->mangleAndIntern(
+                definition->Proto->Name.GetSpelling()));
+        }
+    }
+    if (symbols.empty()) return false;
+
+    if (chunk_count > 1) {
+        if (!AddObjectsInParallel(module_name, generators)) return false;
+    } else if (llvm::Error err = jit_->addIRModule(
+                   generators.front()->TakeModule(module_name))) {
+        std::cerr << "Could not add module: " << llvm::toString(std::move(err))
+                  << '\n';
+        return false;
+    }
+
+    // Compile right away rather than on the first call, so errors and the
+    // compile cost show up where the definitions are made. Objects compiled
+    // in parallel only need linking by now.
+    llvm::TimeTraceScope scope("Compile", module_name);
+    llvm::orc::JITDylib& main_dylib = jit_->getMainJITDylib();
+    if (auto compiled = jit_->getExecutionSession().lookup(
+            llvm::orc::makeJITDylibSearchOrder(&main_dylib),
+            std::move(symbols));
+        !compiled) {
+        std::cerr << "Could not compile definitions: "
+                  << llvm::toString(compiled.takeError()) << '\n';
+        return false;
+    }
+    return true;
+}
+
+bool JitInterpreter::AddObjectsInParallel(
+    const std::string& module_name,
+    const std::vector<std::unique_ptr<IRGenerator>>& generators)
+{
+    // Optimizing and generating machine code dominate, so they run on the
+    // pool too, each chunk with its own target machine. Only linking the
+    // objects into the JIT is left to this thread.
+    const size_t chunk_count = generators.size();
+    std::vector<std::unique_ptr<llvm::MemoryBuffer>> objects(chunk_count);
+    std::vector<std::string> errors(chunk_count);
+    {
+        llvm::TimeTraceScope scope("CompileInParallel", module_name);
+        for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+            codegen_pool_->async([&, chunk] {
+                auto target_machine =
+                    codegen_target_builder_->createTargetMachine();
+                if (!target_machine) {
+                    errors[chunk] = llvm::toString(target_machine.takeError());
+                    return;
+                }
+                OptimizingCompiler compiler(std::move(*target_machine),
+                                            options_.OptLevel,
+                                            object_cache_.get());
+                llvm::orc::ThreadSafeModule module =
+                    generators[chunk]->TakeModule(
+                        fmt::format("{}.{}", module_name, chunk));
+                module.withModuleDo([&](llvm::Module& m) {
+                    // Every definition of the chunk may have been dropped.
+                    if (std::all_of(m.begin(), m.end(),
+                                    [](const llvm::Function& fn) {
+                                        return fn.isDeclaration();
+                                    })) {
+                        return;
+                    }
+                    if (auto object = compiler(m)) {
+                        objects[chunk] = std::move(*object);
+                    } else {
+                        errors[chunk] = llvm::toString(object.takeError());
+                    }
+                });
+            });
+        }
+        codegen_pool_->wait();
+    }
+
+    for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+        if (!errors[chunk].empty()) {
+            std::cerr << "Could not compile definitions: " << errors[chunk]
+                      << '\n';
+            return false;
         }
+        if (!objects[chunk]) continue;
+        if (llvm::Error err = jit_->addObjectFile(std::move(objects[chunk]))) {
+            std::cerr << "Could not add object: "
+                      << llvm::toString(std::move(err)) << '\n';
+            return false;
+        }
+    }
+    return true;
+}
 
-        return ir_builder_->CreateCall(callee_fn, args_ir, "calltmp");
+bool JitInterpreter::AddLazyDefinition(const ast::Fn* definition)
+{
+    // The body is generated on first call, long after the caller's AST is
+    // gone: compile the session's own copy.
+    definition = *definitions_.Find(definition->Proto->Name);
+    const std::string spelling(definition->Proto->Name.GetSpelling());
+    llvm::orc::SymbolStringPtr name = jit_->mangleAndIntern(spelling);
+
+    if (llvm::Error err = impl_dylib_->define(
+            std::make_unique<FunctionAstMaterializationUnit>(
+                name, spelling, definition, jit_->getIRTransformLayer(),
+                jit_->getDataLayout(), function_arities_,
+                memoization_.get(), fast_math_.get(),
+                [this](IRGenerator* generator,
+                       const std::vector<const ast::BaseExpression*>& bodies) {
+                    AddInlineCopies(generator, bodies);
+                }))) {
+        std::cerr << "Could not add definition: "
+                  << llvm::toString(std::move(err)) << '\n';
+        function_arities_.Erase(definition->Proto->Name);
+        definitions_.Erase(definition->Proto->Name);
+        return false;
     }
 
-    return nullptr;
+    llvm::orc::SymbolAliasMap stub_alias;
+    stub_alias[name] = llvm::orc::SymbolAliasMapEntry(
+        name,
+        llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable);
+    ExitOnJitError(jit_->getMainJITDylib().define(llvm::orc::lazyReexports(
+        *lazy_call_through_, *stubs_, *impl_dylib_, std::move(stub_alias))));
+    return true;
 }
 
-void JitInterpreter::EvaluateExpression(const ast::BaseExpression* expression)
+bool JitInterpreter::AddRedefinableDefinition(const ast::Fn* definition)
 {
+    const Symbol name = definition->Proto->Name;
+    const std::string spelling(name.GetSpelling());
+    RedefinableFunction* function = redefinable_functions_.Find(name);
+    const unsigned version = function->Version + 1;
+    const std::string body_name = GetVersionName(spelling, version);
+    llvm::TimeTraceScope scope("Redefine", body_name);
+
+    // Each version gets its own copy of the AST, and its own cache: the
+    // results of the previous version are stale.
+    const auto* body_definition =
+        ast::cast<ast::Fn>(ast::Clone(definition, &definition_nodes_));
+    std::optional<MemoTable> memo_table;
+    if (memoization_ && memoization_->Functions.Contains(name)) {
+        memo_table =
+            CreateMemoTable(body_name, definition->Proto->Args.size());
+    }
+    auto discard_memo_table = [&] {
+        if (memo_table) ExitOnJitError(memo_table->Tracker->remove());
+    };
+
+    llvm::orc::ResourceTrackerSP tracker = impl_dylib_->createResourceTracker();
+    llvm::orc::SymbolStringPtr body_symbol = jit_->mangleAndIntern(body_name);
+    if (llvm::Error err = impl_dylib_->define(
+            std::make_unique<FunctionAstMaterializationUnit>(
+                body_symbol, body_name, body_definition,
+                jit_->getIRTransformLayer(), jit_->getDataLayout(),
+                function_arities_, memoization_.get(), fast_math_.get(),
+                /*inline_copier=*/nullptr),
+            tracker)) {
+        std::cerr << "Could not add definition: "
+                  << llvm::toString(std::move(err)) << '\n';
+        discard_memo_table();
+        return false;
+    }
+
+    llvm::JITTargetAddress body_address = 0;
+    if (options_.LazyCompilation) {
+        // The stub leads to a trampoline that compiles the body, then
+        // points the stub straight at it.
+        auto trampoline = lazy_call_through_->getCallThroughTrampoline(
+            *impl_dylib_, body_symbol,
+            [this, spelling](llvm::JITTargetAddress address) {
+                return stubs_->updatePointer(spelling, address);
+            });
+        if (!trampoline) {
+            std::cerr << "Could not add definition: "
+                      << llvm::toString(trampoline.takeError()) << '\n';
+            ExitOnJitError(tracker->remove());
+            discard_memo_table();
+            return false;
+        }
+        body_address = *trampoline;
+    } else {
+        llvm::TimeTraceScope compile_scope("Compile", body_name);
+        auto body = jit_->lookup(*impl_dylib_, body_name);
+        if (!body) {
+            // Keep calling the previous version.
+            std::cerr << "Could not compile definition: "
+                      << llvm::toString(body.takeError()) << '\n';
+            ExitOnJitError(tracker->remove());
+            discard_memo_table();
+            return false;
+        }
+        body_address = body->getAddress();
+    }
+
+    ExitOnJitError(stubs_->updatePointer(spelling, body_address));
+    if (function->Tracker) ExitOnJitError(function->Tracker->remove());
+    function->Version = version;
+    function->Tracker = std::move(tracker);
+    if (memo_table) {
+        DropMemoTable(name);
+        memo_tables_.Set(name, std::move(*memo_table));
+    }
+    definitions_.Set(name, body_definition);
+
+    // Batch entries inline their own copy of the previous version.
+    if (batch_tracker_) {
+        ExitOnJitError(batch_tracker_->remove());
+        batch_tracker_ = nullptr;
+        batch_entries_ = SymbolMap<llvm::JITTargetAddress>();
+    }
+    return true;
+}
+
+std::vector<std::optional<double>> JitInterpreter::RunExpressions(
+    const std::vector<const ast::BaseExpression*>& expressions)
+{
+    std::vector<std::optional<double>> results(expressions.size());
+
+    // Wrap every expression in its own anonymous function.
+    IRGenerator generator(jit_->getDataLayout(), function_arities_,
+                          /*memoization=*/nullptr, fast_math_.get());
+    std::vector<std::string> names(expressions.size());
+    {
+        llvm::TimeTraceScope scope("GenerateIR", kAnonymousExpressionName);
+        for (size_t i = 0; i < expressions.size(); ++i) {
+            const std::string name =
+                fmt::format("{}.{}", kAnonymousExpressionName, i);
+            const ast::FnPrototype anonymous_proto(symbols_.Intern(name),
+                                                   ast::Span<const Symbol>());
+            if (generator.GenerateFunction(&anonymous_proto,
+                                           expressions[i])) {
+                names[i] = name;
+            }
+        }
+        AddInlineCopies(&generator, expressions);
+    }
+
+    // Track the module memory so it can be freed after running it.
+    llvm::orc::ResourceTrackerSP tracker =
+        jit_->getMainJITDylib().createResourceTracker();
+    if (llvm::Error err = jit_->addIRModule(
+            tracker, generator.TakeModule(kAnonymousExpressionName))) {
+        std::cerr << "Could not add module: " << llvm::toString(std::move(err))
+                  << '\n';
+        return results;
+    }
+
+    for (size_t i = 0; i < expressions.size(); ++i) {
+        if (names[i].empty()) continue;
+        // The first lookup compiles the whole module.
+        auto symbol = [&] {
+            llvm::TimeTraceScope scope("Compile", names[i]);
+            return jit_->lookup(names[i]);
+        }();
+        if (symbol) {
+            auto* fn_ptr = llvm::jitTargetAddressToFunction<double (*)()>(
+                symbol->getAddress());
+            llvm::TimeTraceScope scope("Run", names[i]);
+            results[i] = fn_ptr();
+        } else {
+            std::cerr << "Could not compile expression: "
+                      << llvm::toString(symbol.takeError()) << '\n';
+        }
+    }
+
+    ExitOnJitError(tracker->remove());
+    return results;
+}
+
+void JitInterpreter::AddTieredDefinition(const ast::Fn* definition)
+{
+    // Interpreted and compiled long after the caller's AST is gone.
+    TieredFunction function;
+    function.Definition = *definitions_.Find(definition->Proto->Name);
+    tiered_functions_.Set(definition->Proto->Name, function);
+}
+
+std::optional<double> JitInterpreter::Interpret(
+    const ast::BaseExpression* expression)
+{
+    llvm::TimeTraceScope scope("Interpret");
+    return evaluator::Evaluate(expression, {}, {}, this);
+}
+
+std::optional<double> JitInterpreter::Call(Symbol callee,
+                                           ast::Span<const double> args)
+{
+    // Calls never define functions, so the entry stays in place for the
+    // whole call.
+    TieredFunction* function = tiered_functions_.Find(callee);
+    if (!function) {
+        std::cerr << "Unknown function referenced\n";
+        return std::nullopt;
+    }
+    const size_t* arity = function_arities_.Find(callee);
+    if (!arity || *arity != args.size()) {
+        std::cerr << "Incorrect # arguments passed\n";
+        return std::nullopt;
+    }
+
+    if (!function->Entry) {
+        if (!function->Definition) {
+            function->Entry = CompileExternEntry(callee);
+            if (!function->Entry) return std::nullopt;
+        } else if (function->Calls >= options_.TierUpThreshold &&
+                   !function->CompileFailed) {
+            CompileTieredFunction(callee);
+        }
+    }
+    if (function->Entry) {
+        auto* entry = llvm::jitTargetAddressToFunction<double (*)(
+            const double*)>(function->Entry);
+        return entry(args.begin());
+    }
+
+    ++tier_stats_.InterpretedCalls;
+    const ast::Fn* definition = function->Definition;
+    std::optional<double> result = evaluator::Evaluate(
+        definition->Body, definition->Proto->Args, args, this);
+    // Only calls that ran through count. Without branches every run
+    // reaches the whole body, so a function is compiled only once it and
+    // everything it calls are known to lower cleanly.
+    if (result) ++function->Calls;
+    return result;
+}
+
+void JitInterpreter::CompileTieredFunction(Symbol name)
+{
+    // Compiled code only calls compiled code, so the function is compiled
+    // together with every interpreted function it may reach.
+    std::vector<const ast::Fn*> definitions;
+    SymbolMap<bool> visited;
+    std::vector<Symbol> worklist = {name};
+    while (!worklist.empty()) {
+        const Symbol next = worklist.back();
+        worklist.pop_back();
+        if (visited.Contains(next)) continue;
+        visited.Set(next, true);
+
+        const TieredFunction* function = tiered_functions_.Find(next);
+        if (!function || !function->Definition || function->Entry) continue;
+        definitions.push_back(function->Definition);
+        CollectCallees(function->Definition->Body, &worklist);
+    }
+
+    llvm::TimeTraceScope scope("TierUp", name.GetSpelling());
+    const bool compiled = AddDefinitions(
+        definitions, std::string(name.GetSpelling()), /*array_entries=*/true);
+    for (const ast::Fn* definition : definitions) {
+        TieredFunction* function =
+            tiered_functions_.Find(definition->Proto->Name);
+        if (compiled) {
+            auto entry = jit_->lookup(IRGenerator::GetArrayEntryName(
+                definition->Proto->Name.GetSpelling()));
+            if (entry) {
+                function->Entry = entry->getAddress();
+                ++tier_stats_.CompiledFunctions;
+                continue;
+            }
+            llvm::consumeError(entry.takeError());
+        }
+        // Keep running it in the interpreter.
+        function->CompileFailed = true;
+    }
+}
+
+llvm::JITTargetAddress JitInterpreter::CompileExternEntry(Symbol name)
+{
+    IRGenerator generator(jit_->getDataLayout(), function_arities_);
+    if (!generator.GenerateArrayEntry(name)) return 0;
+    const std::string entry_name =
+        IRGenerator::GetArrayEntryName(name.GetSpelling());
+
+    // Dropped again if the extern cannot be resolved, so that a later call
+    // can retry once it is defined.
+    llvm::orc::ResourceTrackerSP tracker =
+        jit_->getMainJITDylib().createResourceTracker();
+    if (llvm::Error err =
+            jit_->addIRModule(tracker, generator.TakeModule(entry_name))) {
+        std::cerr << "Could not add module: " << llvm::toString(std::move(err))
+                  << '\n';
+        return 0;
+    }
+    auto entry = jit_->lookup(entry_name);
+    if (!entry) {
+        std::cerr << "Could not call " << name.GetSpelling() << ": "
+                  << llvm::toString(entry.takeError()) << '\n';
+        ExitOnJitError(tracker->remove());
+        return 0;
+    }
+    return entry->getAddress();
+}
+
+llvm::JITTargetAddress JitInterpreter::CompileBatchEntry(Symbol name)
+{
+    const std::string entry_name =
+        IRGenerator::GetBatchEntryName(name.GetSpelling());
+    llvm::TimeTraceScope scope("CompileBatch", entry_name);
+
+    // The module gets its own copy of every function the loop may reach,
+    // so that the whole call tree can be inlined into it. Externs stay
+    // declarations.
+    IRGenerator generator(jit_->getDataLayout(), function_arities_,
+                          /*memoization=*/nullptr, fast_math_.get());
+    {
+        llvm::TimeTraceScope generate_scope("GenerateIR", entry_name);
+        SymbolMap<bool> visited;
+        std::vector<Symbol> worklist = {name};
+        while (!worklist.empty()) {
+            const Symbol next = worklist.back();
+            worklist.pop_back();
+            if (visited.Contains(next)) continue;
+            visited.Set(next, true);
+
+            const ast::Fn* const* definition = definitions_.Find(next);
+            if (!definition) continue;
+            if (!generator.GenerateFunction((*definition)->Proto,
+                                            (*definition)->Body)) {
+                return 0;
+            }
+            CollectCallees((*definition)->Body, &worklist);
+        }
+        if (!generator.GenerateBatchEntry(name)) return 0;
+    }
+
+    auto target_machine =
+        ExitOnJitError(llvm::orc::JITTargetMachineBuilder::detectHost())
+            .createTargetMachine();
+    if (!target_machine) {
+        std::cerr << "Could not compile batch: "
+                  << llvm::toString(target_machine.takeError()) << '\n';
+        return 0;
+    }
+    llvm::orc::ThreadSafeModule module = generator.TakeModule(entry_name);
+    module.withModuleDo([&](llvm::Module& m) {
+        // The copies must not clash with the functions already compiled.
+        for (llvm::Function& fn : m) {
+            if (!fn.isDeclaration() && fn.getName() != entry_name) {
+                fn.setLinkage(llvm::GlobalValue::InternalLinkage);
+            }
+        }
+        optimizer::OptimizeModule(m, OptimizationLevel::kO3,
+                                  target_machine->get());
+    });
+
+    if (!batch_tracker_) {
+        batch_tracker_ = jit_->getMainJITDylib().createResourceTracker();
+    }
+    if (llvm::Error err =
+            jit_->addIRModule(batch_tracker_, std::move(module))) {
+        std::cerr << "Could not add module: " << llvm::toString(std::move(err))
+                  << '\n';
+        return 0;
+    }
+    auto entry = jit_->lookup(entry_name);
+    if (!entry) {
+        std::cerr << "Could not compile batch: "
+                  << llvm::toString(entry.takeError()) << '\n';
+        return 0;
+    }
+    return entry->getAddress();
+}
+
+std::optional<double> JitInterpreter::EvaluateExpression(
+    const ast::BaseExpression* expression)
+{
+    llvm::TimeTraceScope scope("EvaluateExpression");
     if (const ast::FnPrototype* extern_call =
-            dynamic_cast<const ast::FnPrototype*>(expression)) {
-        llvm::Function* fn =
-            GeneratePrototype(extern_call, *context_, module_.get());
-        fn->print(llvm::outs());
-        return;
-    }
-    if (llvm::Value* val = GenerateIR(expression)) {
-        val->print(llvm::outs());
-        std::cout << '\n';
-        return;
-    }
-
-    // TODO: Remove this later
-    std::string res;
-    expression->PrintToString(res, 0, '=');
-    std::cout << res;
+            ast::dyn_cast<ast::FnPrototype>(expression)) {
+        DeclareExtern(extern_call);
+        return std::nullopt;
+    }
+    if (const ast::Fn* definition = ast::dyn_cast<ast::Fn>(expression)) {
+        // Register the arity first, the body may call itself.
+        if (!DeclareDefinition(definition)) return std::nullopt;
+        if (options_.TierUpThreshold > 0) {
+            AddTieredDefinition(definition);
+        } else if (IsRedefinitionEnabled()) {
+            AddRedefinableDefinition(definition);
+        } else if (options_.LazyCompilation) {
+            AddLazyDefinition(definition);
+        } else {
+            AddDefinitions({definition},
+                           std::string(definition->Proto->Name.GetSpelling()));
+        }
+        return std::nullopt;
+    }
+
+    if (options_.TierUpThreshold > 0) return Interpret(expression);
+
+    // Top-level expression, wrap it in an anonymous function and run it.
+    return RunExpressions({expression}).front();
+}
+
+std::vector<std::optional<double>> JitInterpreter::EvaluateUnit(
+    const ast::CompilationUnit& unit)
+{
+    llvm::TimeTraceScope scope("EvaluateUnit");
+    // Declare every item up front, so that any item can refer to functions
+    // defined later in the unit.
+    std::vector<const ast::Fn*> definitions;
+    std::vector<const ast::BaseExpression*> expressions;
+    for (const ast::BaseExpression* item : unit.Items) {
+        if (const ast::FnPrototype* extern_call =
+                ast::dyn_cast<ast::FnPrototype>(item)) {
+            DeclareExtern(extern_call);
+        } else if (const ast::Fn* definition =
+                       ast::dyn_cast<ast::Fn>(item)) {
+            if (DeclareDefinition(definition)) {
+                definitions.push_back(definition);
+            }
+        } else {
+            expressions.push_back(item);
+        }
+    }
+
+    if (options_.TierUpThreshold > 0) {
+        for (const ast::Fn* definition : definitions) {
+            AddTieredDefinition(definition);
+        }
+        std::vector<std::optional<double>> results;
+        for (const ast::BaseExpression* expression : expressions) {
+            results.push_back(Interpret(expression));
+        }
+        return results;
+    }
+
+    // All the definitions of the unit go into a single module, unless each
+    // needs a module of its own to be replaced later.
+    if (IsRedefinitionEnabled()) {
+        for (const ast::Fn* definition : definitions) {
+            AddRedefinableDefinition(definition);
+        }
+    } else if (options_.LazyCompilation) {
+        for (const ast::Fn* definition : definitions) {
+            AddLazyDefinition(definition);
+        }
+    } else if (!definitions.empty()) {
+        AddDefinitions(definitions, kUnitModuleName);
+    }
+
+    if (expressions.empty()) return {};
+    return RunExpressions(expressions);
+}
+
+std::vector<std::optional<double>> JitInterpreter::EvaluateSource(
+    std::string source)
+{
+    LexerImpl lexer(std::move(source));
+    ast::CompilationUnit& unit = source_units_.emplace_back(
+        parser::ParseCompilationUnit(&lexer, &symbols_));
+    simplifier::SimplifyCompilationUnit(&unit);
+    return EvaluateUnit(unit);
+}
+
+llvm::JITTargetAddress JitInterpreter::GetFunctionAddress(
+    std::string_view name, size_t arity)
+{
+    const Symbol symbol = symbols_.Find(name);
+    const size_t* known_arity =
+        symbol.IsValid() ? function_arities_.Find(symbol) : nullptr;
+    if (!known_arity) {
+        std::cerr << "Unknown function referenced\n";
+        return 0;
+    }
+    if (*known_arity != arity) {
+        std::cerr << "Incorrect # arguments passed\n";
+        return 0;
+    }
+
+    if (TieredFunction* function = tiered_functions_.Find(symbol);
+        function && function->Definition) {
+        if (!function->Entry && !function->CompileFailed) {
+            CompileTieredFunction(symbol);
+        }
+        if (!function->Entry) return 0;
+    }
+
+    // Externs resolve to the host process, lazy and redefinable functions
+    // to their stub.
+    auto address = jit_->lookup(name);
+    if (!address) {
+        std::cerr << "Could not compile " << name << ": "
+                  << llvm::toString(address.takeError()) << '\n';
+        return 0;
+    }
+    return address->getAddress();
+}
+
+bool JitInterpreter::EvaluateBatch(std::string_view name,
+                                   const std::vector<const double*>& columns,
+                                   size_t rows, double* out)
+{
+    llvm::TimeTraceScope scope("EvaluateBatch", name);
+    const Symbol symbol = symbols_.Find(name);
+    const size_t* arity =
+        symbol.IsValid() ? function_arities_.Find(symbol) : nullptr;
+    if (!arity) {
+        std::cerr << "Unknown function referenced\n";
+        return false;
+    }
+    if (*arity != columns.size()) {
+        std::cerr << "Incorrect # arguments passed\n";
+        return false;
+    }
+
+    const llvm::JITTargetAddress* entry = batch_entries_.Find(symbol);
+    if (!entry) {
+        const llvm::JITTargetAddress compiled = CompileBatchEntry(symbol);
+        if (!compiled) return false;
+        batch_entries_.Set(symbol, compiled);
+        entry = batch_entries_.Find(symbol);
+    }
+    if (rows == 0) return true;
+
+    auto* batch = llvm::jitTargetAddressToFunction<void (*)(
+        const double* const*, double*, uint64_t)>(*entry);
+    llvm::TimeTraceScope run_scope("Run", name);
+    batch(columns.data(), out, rows);
+    return true;
+}
+
+SymbolTable& JitInterpreter::GetSymbolTable() { return symbols_; }
+
+ObjectCacheStats JitInterpreter::GetObjectCacheStats() const
+{
+    return object_cache_ ? object_cache_->GetStats() : ObjectCacheStats();
+}
+
+TierStats JitInterpreter::GetTierStats() const { return tier_stats_; }
+
+std::optional<MemoStats> JitInterpreter::GetMemoStats(
+    std::string_view name) const
+{
+    const Symbol symbol = symbols_.Find(name);
+    const MemoTable* table =
+        symbol.IsValid() ? memo_tables_.Find(symbol) : nullptr;
+    if (!table) return std::nullopt;
+    MemoStats stats;
+    stats.Hits = table->Words[IRGenerator::kMemoHitsWord].load(
+        std::memory_order_relaxed);
+    stats.Misses = table->Words[IRGenerator::kMemoMissesWord].load(
+        std::memory_order_relaxed);
+    return stats;
 }
 
 JitInterpreter::~JitInterpreter() = default;
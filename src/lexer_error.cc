@@ -8,7 +8,7 @@ LexerError::~LexerError() = default;
 
 LexerError::LexerError(char ch)
     : message_(fmt::format(
-          "Could not continue parsing, unknown character found: '{}'", ch))
+          "Unknown character '{}'", ch))
 
 {
 }
@@ -1,9 +1,11 @@
 #include "kaleidoscope/lexer_impl.h"
 
+#include "kaleidoscope/char_scanner.h"
 #include "kaleidoscope/lexer_error.h"
 #include "kaleidoscope/token.h"
 
-#include <algorithm>
+#include <llvm/Support/TimeProfiler.h>
+
 #include <array>
 #include <utility>
 
@@ -14,33 +16,72 @@ namespace kaleidoscope
 
 namespace
 {
-const std::string_view kDefKeyword = "def"sv;
-const std::string_view kExternKeyword = "extern"sv;
-
-static constexpr std::array<std::pair<unsigned char, TokenType>, 7>
-    kAllowedCharacters{{{'(', TokenType::kLeftParen},
-                        {')', TokenType::kRightParen},
-                        {'+', TokenType::kPlusSign},
-                        {'-', TokenType::kMinusSign},
-                        {'*', TokenType::kAsterisk},
-                        {',', TokenType::kComma},
-                        {'.', TokenType::kDot}}};
-
-std::string::const_iterator AdvanceInputPos(
-    const std::string::const_iterator& curr_pos,
-    const std::string::const_iterator& end_it)
+using scanner::IsInClass;
+
+struct Keyword {
+    std::string_view Spelling;
+    TokenType Type;
+};
+
+// Length plus first character is a perfect hash over the reserved words, so
+// telling an identifier apart takes one table load and one comparison.
+constexpr size_t kKeywordSlots = 8;
+
+constexpr size_t KeywordSlot(std::string_view word)
+{
+    return (word.size() + static_cast<unsigned char>(word.front())) &
+           (kKeywordSlots - 1);
+}
+
+constexpr std::array<Keyword, kKeywordSlots> BuildKeywordTable()
 {
-    std::string::const_iterator new_pos = curr_pos;
-    while (new_pos != end_it &&
-           std::isspace(static_cast<unsigned char>(*new_pos))) {
-        new_pos++;
+    std::array<Keyword, kKeywordSlots> table{};
+    for (const Keyword& keyword : {Keyword{"def"sv, TokenType::kDef},
+                                   Keyword{"extern"sv, TokenType::kExtern}}) {
+        table[KeywordSlot(keyword.Spelling)] = keyword;
     }
-    return new_pos;
+    return table;
 }
+
+constexpr std::array<Keyword, kKeywordSlots> kKeywords = BuildKeywordTable();
+static_assert(kKeywords[KeywordSlot("def"sv)].Type == TokenType::kDef &&
+                  kKeywords[KeywordSlot("extern"sv)].Type ==
+                      TokenType::kExtern,
+              "reserved words must hash to distinct slots");
+
+TokenType ClassifyWord(std::string_view word)
+{
+    const Keyword& keyword = kKeywords[KeywordSlot(word)];
+    return keyword.Spelling == word ? keyword.Type : TokenType::kIdentifier;
+}
+
+constexpr std::array<TokenType, 256> BuildPunctuationTable()
+{
+    // Only read for characters of the kPunctuation class.
+    std::array<TokenType, 256> table{};
+    table['('] = TokenType::kLeftParen;
+    table[')'] = TokenType::kRightParen;
+    table['+'] = TokenType::kPlusSign;
+    table['-'] = TokenType::kMinusSign;
+    table['*'] = TokenType::kAsterisk;
+    table[','] = TokenType::kComma;
+    table['.'] = TokenType::kDot;
+    return table;
+}
+
+constexpr std::array<TokenType, 256> kPunctuation = BuildPunctuationTable();
 }  // namespace
 
 LexerImpl::LexerImpl(std::string input)
-    : input_(std::move(input)), input_to_process_(input_.data(), input_.size())
+    : LexerImpl(SourceBuffer::FromString(std::move(input)))
+{
+}
+
+LexerImpl::LexerImpl(SourceBuffer source)
+    : source_(std::move(source)),
+      input_to_process_(source_.Contents()),
+      kernels_(scanner::SelectedKernels()),
+      trace_tokens_(llvm::timeTraceProfilerEnabled())
 {
 }
 
@@ -50,69 +91,54 @@ tl::expected<Token, LexerError> LexerImpl::PeekToken()
 {
     if (next_token_.has_value()) return next_token_.value();
 
-    // Trim the input
-    auto trim_it =
-        std::find_if(input_to_process_.begin(), input_to_process_.end(),
-                     [](unsigned char ch) { return !std::isspace(ch); });
-
-    if (trim_it == input_to_process_.end()) {
-        return next_token_.emplace(Token(TokenType::kEof, std::string_view()));
-    }
-    // Advance the string view to ignore whitespaces
-    input_to_process_ =
-        input_to_process_.substr(trim_it - input_to_process_.begin());
-
-    const unsigned char next_char =
-        static_cast<unsigned char>(input_to_process_.front());
-    if (std::isalpha(next_char)) {
-        // Find the last consecutive alphanumeric character
-        auto identifier_it =
-            std::find_if(input_to_process_.begin(), input_to_process_.end(),
-                         [](unsigned char ch) { return !std::isalnum(ch); });
-        const std::string_view next_alpha_num = input_to_process_.substr(
-            0, identifier_it - input_to_process_.begin());
-        TokenType token_found = TokenType::kIdentifier;
-        //  Check for reserved words
-        if (next_alpha_num == kDefKeyword) {
-            token_found = TokenType::kDef;
-        } else if (next_alpha_num == kExternKeyword) {
-            token_found = TokenType::kExtern;
-        }
-
-        // Consume the identifier
-        input_to_process_ = input_to_process_.substr(next_alpha_num.size());
-
-        return next_token_.emplace(Token(token_found, next_alpha_num));
+    // The parser pulls tokens one at a time, so lexing can only be traced
+    // per token. Those scopes are far below any useful granularity, they
+    // only add up in the "Total Lex" summary of the trace.
+    if (trace_tokens_) {
+        llvm::TimeTraceScope scope("Lex");
+        return next_token_.emplace(LexToken());
     }
+    return next_token_.emplace(LexToken());
+}
 
-    if (std::isdigit(next_char)) {
-        // Find the last consecutive digit character
-        auto num_it =
-            std::find_if(input_to_process_.begin(), input_to_process_.end(),
-                         [](unsigned char ch) { return !std::isdigit(ch); });
-        const std::string_view next_digit =
-            input_to_process_.substr(0, num_it - input_to_process_.begin());
-
-        // Consume the identifier
-        input_to_process_ = input_to_process_.substr(next_digit.size());
-        return next_token_.emplace(Token(TokenType::kNumber, next_digit));
+tl::expected<Token, LexerError> LexerImpl::LexToken()
+{
+    const char* const begin = input_to_process_.data();
+    const char* const end = begin + input_to_process_.size();
+
+    // Skip the whitespace in front of the token
+    const char* token_begin = kernels_.SkipWhitespace(begin, end);
+    input_to_process_.remove_prefix(token_begin - begin);
+    next_token_offset_ = token_begin - source_.Contents().data();
+    if (token_begin == end) {
+        return Token(TokenType::kEof, std::string_view());
     }
 
-    // Check if the next token is a valid character
-    if (auto it = std::find_if(
-            kAllowedCharacters.begin(), kAllowedCharacters.end(),
-            [&next_char](const auto& p) { return p.first == next_char; });
-        it != kAllowedCharacters.end()) {
-        next_token_.emplace(
-            Token((*it).second, input_to_process_.substr(0, 1)));
+    const unsigned char next_char = static_cast<unsigned char>(*token_begin);
+    if (IsInClass(next_char, scanner::kAlpha)) {
+        const char* token_end = kernels_.SkipAlphaNumeric(token_begin, end);
+        const std::string_view next_alpha_num(token_begin,
+                                              token_end - token_begin);
+        input_to_process_.remove_prefix(next_alpha_num.size());
+        return Token(ClassifyWord(next_alpha_num), next_alpha_num);
+    }
 
-        input_to_process_ = input_to_process_.substr(1);
+    if (IsInClass(next_char, scanner::kDigit)) {
+        const char* token_end = kernels_.SkipDigits(token_begin, end);
+        const std::string_view next_digit(token_begin,
+                                          token_end - token_begin);
+        input_to_process_.remove_prefix(next_digit.size());
+        return Token(TokenType::kNumber, next_digit);
+    }
 
-        return next_token_.value();
+    if (IsInClass(next_char, scanner::kPunctuation)) {
+        const std::string_view next_punctuation(token_begin, 1);
+        input_to_process_.remove_prefix(1);
+        return Token(kPunctuation[next_char], next_punctuation);
     }
 
     // Invalid character, return error
-    return next_token_.emplace(tl::unexpected<LexerError>(next_char));
+    return tl::unexpected<LexerError>(next_char);
 }
 
 void LexerImpl::ConsumeToken()
@@ -120,11 +146,21 @@ void LexerImpl::ConsumeToken()
     // If token has not been peeked, do it and continue
     if (!next_token_.has_value()) PeekToken();
 
-    // Do not advance if EOF has been reached, or an error has been found
+    // Do not advance if EOF has been reached
     const tl::expected<Token, LexerError>& token = next_token_.value();
-    if (!token.has_value() || token->Type == TokenType::kEof) return;
+    if (token.has_value() && token->Type == TokenType::kEof) return;
 
+    // The character that failed to lex is still in front of the input
+    if (!token.has_value()) input_to_process_.remove_prefix(1);
     next_token_.reset();
 }
 
+size_t LexerImpl::GetOffset()
+{
+    if (!next_token_.has_value()) PeekToken();
+    return next_token_offset_;
+}
+
+std::string_view LexerImpl::GetSource() const { return source_.Contents(); }
+
 }  // namespace kaleidoscope
@@ -0,0 +1,102 @@
+#include "kaleidoscope/object_cache.h"
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Process.h>
+#include <llvm/Support/SHA1.h>
+#include <llvm/Support/Threading.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include <iostream>
+#include <utility>
+
+namespace kaleidoscope
+{
+
+DiskObjectCache::DiskObjectCache(std::string directory)
+    : directory_(std::move(directory))
+{
+    if (std::error_code ec = llvm::sys::fs::create_directories(directory_)) {
+        std::cerr << "Could not create object cache directory " << directory_
+                  << ": " << ec.message() << '\n';
+    }
+}
+
+DiskObjectCache::~DiskObjectCache() = default;
+
+std::string DiskObjectCache::ComputeKey(
+    const llvm::Module& module, const llvm::TargetMachine& target_machine,
+    OptimizationLevel level)
+{
+    std::string ir;
+    llvm::raw_string_ostream ir_stream(ir);
+    module.print(ir_stream, nullptr);
+    ir_stream.flush();
+
+    llvm::SHA1 hasher;
+    hasher.update(ir);
+    hasher.update(target_machine.getTargetTriple().str());
+    hasher.update(target_machine.getTargetCPU());
+    hasher.update(target_machine.getTargetFeatureString());
+    hasher.update(OptimizationLevelToString(level));
+    return llvm::toHex(hasher.final(), /*LowerCase=*/true);
+}
+
+std::string DiskObjectCache::GetObjectPath(const std::string& key) const
+{
+    llvm::SmallString<128> path(directory_);
+    llvm::sys::path::append(path, key + ".o");
+    return std::string(path.str());
+}
+
+std::unique_ptr<llvm::MemoryBuffer> DiskObjectCache::Lookup(
+    const std::string& key)
+{
+    auto object = llvm::MemoryBuffer::getFile(GetObjectPath(key));
+    if (!object) {
+        ++misses_;
+        return nullptr;
+    }
+    ++hits_;
+    return std::move(object.get());
+}
+
+void DiskObjectCache::Store(const std::string& key,
+                            llvm::MemoryBufferRef object)
+{
+    // Write to a private file first and rename it into place, so that
+    // concurrent readers never see a partially written object. Compile
+    // threads of the same process may store the same key too.
+    const std::string path = GetObjectPath(key);
+    const std::string tmp_path =
+        path + ".tmp" + std::to_string(llvm::sys::Process::getProcessId()) +
+        "." + std::to_string(llvm::get_threadid());
+    {
+        std::error_code ec;
+        llvm::raw_fd_ostream out(tmp_path, ec);
+        if (ec) return;
+        out << object.getBuffer();
+        if (out.has_error()) {
+            out.clear_error();
+            llvm::sys::fs::remove(tmp_path);
+            return;
+        }
+    }
+    if (llvm::sys::fs::rename(tmp_path, path)) {
+        llvm::sys::fs::remove(tmp_path);
+    }
+}
+
+ObjectCacheStats DiskObjectCache::GetStats() const
+{
+    ObjectCacheStats stats;
+    stats.Hits = hits_;
+    stats.Misses = misses_;
+    return stats;
+}
+
+}  // namespace kaleidoscope
@@ -0,0 +1,67 @@
+#include "kaleidoscope/optimizer.h"
+
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/PassManager.h>
+#include <llvm/Passes/OptimizationLevel.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/Target/TargetMachine.h>
+
+namespace kaleidoscope
+{
+
+namespace
+{
+llvm::OptimizationLevel ToLLVMOptimizationLevel(OptimizationLevel level)
+{
+    switch (level) {
+        case OptimizationLevel::kO0:
+            return llvm::OptimizationLevel::O0;
+        case OptimizationLevel::kO1:
+            return llvm::OptimizationLevel::O1;
+        case OptimizationLevel::kO2:
+            return llvm::OptimizationLevel::O2;
+        case OptimizationLevel::kO3:
+            return llvm::OptimizationLevel::O3;
+    }
+    return llvm::OptimizationLevel::O0;
+}
+}  // namespace
+
+namespace optimizer
+{
+void OptimizeModule(llvm::Module& module, OptimizationLevel level,
+                    llvm::TargetMachine* target_machine)
+{
+    // Nothing to do but inlining copies of other modules' functions, and
+    // even the O0 pipeline has a cost.
+    if (level == OptimizationLevel::kO0 &&
+        llvm::none_of(module, [](const llvm::Function& fn) {
+            return fn.hasFnAttribute(llvm::Attribute::AlwaysInline);
+        })) {
+        return;
+    }
+
+    llvm::TimeTraceScope scope("Optimize", module.getModuleIdentifier());
+
+    llvm::LoopAnalysisManager loop_analysis;
+    llvm::FunctionAnalysisManager function_analysis;
+    llvm::CGSCCAnalysisManager cgscc_analysis;
+    llvm::ModuleAnalysisManager module_analysis;
+
+    llvm::PassBuilder pass_builder(target_machine);
+    pass_builder.registerModuleAnalyses(module_analysis);
+    pass_builder.registerCGSCCAnalyses(cgscc_analysis);
+    pass_builder.registerFunctionAnalyses(function_analysis);
+    pass_builder.registerLoopAnalyses(loop_analysis);
+    pass_builder.crossRegisterProxies(loop_analysis, function_analysis,
+                                      cgscc_analysis, module_analysis);
+
+    llvm::ModulePassManager pass_manager =
+        pass_builder.buildPerModuleDefaultPipeline(
+            ToLLVMOptimizationLevel(level));
+    pass_manager.run(module, module_analysis);
+}
+}  // namespace optimizer
+}  // namespace kaleidoscope
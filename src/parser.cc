@@ -6,91 +6,325 @@
 #include "kaleidoscope/ast/fn.h"
 #include "kaleidoscope/ast/number.h"
 #include "kaleidoscope/ast/variable.h"
+#include "kaleidoscope/char_scanner.h"
+#include "kaleidoscope/diagnostic.h"
 #include "kaleidoscope/lexer_error.h"
 #include "kaleidoscope/lexer.h"
+#include "kaleidoscope/lexer_impl.h"
+#include "kaleidoscope/source_buffer.h"
+#include "kaleidoscope/symbol_table.h"
 #include "kaleidoscope/token.h"
 
+#include <fmt/core.h>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/TimeProfiler.h>
+
+#include <algorithm>
+#include <atomic>
 #include <charconv>
 #include <iostream>
-#include <stdexcept>
+#include <string>
+#include <string_view>
 #include <vector>
 
 namespace kaleidoscope
 {
 namespace
 {
+using Diagnostics = std::vector<Diagnostic>;
+
 // Forward declarations
-std::unique_ptr<ast::Fn> ParseNextTopLevelExpression(Lexer* lexer);
-std::unique_ptr<ast::Fn> ParseDefinition(Lexer* lexer);
-std::unique_ptr<ast::FnPrototype> ParseExtern(Lexer* lexer);
-std::unique_ptr<ast::FnPrototype> ParsePrototype(Lexer* lexer);
-std::unique_ptr<ast::BaseExpression> ParseExpression(Lexer* lexer);
-std::unique_ptr<ast::BaseExpression> ParsePrimaryExpression(Lexer* lexer);
-std::unique_ptr<ast::BaseExpression> ParseBinaryOpRhs(
-    Lexer* lexer, int expression_precedence,
-    std::unique_ptr<ast::BaseExpression> lhs_expression);
-std::unique_ptr<ast::BaseExpression> ParseParenthesesExpression(Lexer* lexer);
-std::unique_ptr<ast::BaseExpression> ParseIdentifierExpression(Lexer* lexer);
-std::unique_ptr<ast::BaseExpression> ParseNumberExpression(Lexer* lexer);
+std::nullptr_t ReportError(Lexer* lexer, Diagnostics* diagnostics,
+                           DiagnosticCode code, std::string message);
+std::nullptr_t ReportLexerError(Lexer* lexer, Diagnostics* diagnostics,
+                                const LexerError& error);
+void SkipToNextItem(Lexer* lexer, Diagnostics* diagnostics);
+void FinishDiagnostics(std::string_view source, Diagnostics* diagnostics,
+                       size_t first, bool print);
+const ast::Fn* ParseDefinition(Lexer* lexer, ast::Arena* arena,
+                               SymbolTable* symbols,
+                               Diagnostics* diagnostics);
+const ast::FnPrototype* ParseExtern(Lexer* lexer, ast::Arena* arena,
+                                    SymbolTable* symbols,
+                                    Diagnostics* diagnostics);
+const ast::FnPrototype* ParsePrototype(Lexer* lexer, ast::Arena* arena,
+                                       SymbolTable* symbols,
+                                       Diagnostics* diagnostics);
+const ast::BaseExpression* ParseExpression(Lexer* lexer, ast::Arena* arena,
+                                           SymbolTable* symbols,
+                                           Diagnostics* diagnostics);
+const ast::BaseExpression* ParsePrimaryExpression(Lexer* lexer,
+                                                  ast::Arena* arena,
+                                                  SymbolTable* symbols,
+                                                  Diagnostics* diagnostics);
+const ast::BaseExpression* ParseBinaryOpRhs(
+    Lexer* lexer, ast::Arena* arena, SymbolTable* symbols,
+    Diagnostics* diagnostics, int expression_precedence,
+    const ast::BaseExpression* lhs_expression);
+const ast::BaseExpression* ParseParenthesesExpression(Lexer* lexer,
+                                                      ast::Arena* arena,
+                                                      SymbolTable* symbols,
+                                                      Diagnostics* diagnostics);
+const ast::BaseExpression* ParseIdentifierExpression(Lexer* lexer,
+                                                     ast::Arena* arena,
+                                                     SymbolTable* symbols,
+                                                     Diagnostics* diagnostics);
+const ast::BaseExpression* ParseNumberExpression(Lexer* lexer,
+                                                 ast::Arena* arena,
+                                                 Diagnostics* diagnostics);
+const ast::BaseExpression* ParseItem(Lexer* lexer, ast::Arena* arena,
+                                     SymbolTable* symbols,
+                                     Diagnostics* diagnostics);
+void ParseItems(Lexer* lexer, SymbolTable* symbols,
+                ast::CompilationUnit* unit, Diagnostics* diagnostics);
+std::vector<std::string_view> SplitAtItems(std::string_view source,
+                                           size_t max_pieces);
 }  // namespace
 
 namespace parser
 {
+const ast::BaseExpression* ParseNextExpression(
+    Lexer* lexer, ast::Arena* arena, SymbolTable* symbols,
+    std::vector<Diagnostic>* diagnostics)
+{
+    Diagnostics printed;
+    Diagnostics* collected = diagnostics ? diagnostics : &printed;
+    const size_t first = collected->size();
+    const ast::BaseExpression* item =
+        ParseItem(lexer, arena, symbols, collected);
+    FinishDiagnostics(lexer->GetSource(), collected, first,
+                      /*print=*/!diagnostics);
+    return item;
+}
+
+ast::CompilationUnit ParseCompilationUnit(Lexer* lexer, SymbolTable* symbols,
+                                          std::vector<Diagnostic>* diagnostics)
+{
+    llvm::TimeTraceScope scope("ParseUnit");
+    ast::CompilationUnit unit;
+    Diagnostics printed;
+    Diagnostics* collected = diagnostics ? diagnostics : &printed;
+    const size_t first = collected->size();
+    ParseItems(lexer, symbols, &unit, collected);
+    FinishDiagnostics(lexer->GetSource(), collected, first,
+                      /*print=*/!diagnostics);
+    return unit;
+}
+
+ast::CompilationUnit ParseCompilationUnitInParallel(
+    std::string_view source, SymbolTable* symbols, unsigned threads,
+    std::vector<Diagnostic>* diagnostics)
+{
+    llvm::TimeTraceScope scope("ParseUnitInParallel");
+    // A few pieces per thread even out items of different sizes.
+    const std::vector<std::string_view> pieces =
+        SplitAtItems(source, threads > 1 ? threads * 4 : 1);
+
+    std::vector<ast::CompilationUnit> piece_units(pieces.size());
+    std::vector<Diagnostics> piece_diagnostics(pieces.size());
+    auto parse_piece = [&](size_t piece, SymbolTable* piece_symbols) {
+        LexerImpl lexer(SourceBuffer::FromView(pieces[piece]));
+        ParseItems(&lexer, piece_symbols, &piece_units[piece],
+                   &piece_diagnostics[piece]);
+    };
+    if (pieces.size() == 1) {
+        parse_piece(0, symbols);
+    } else {
+        llvm::ThreadPool pool(llvm::hardware_concurrency(threads));
+        std::atomic<size_t> next_piece = 0;
+        for (unsigned worker = 0; worker < pool.getThreadCount(); ++worker) {
+            pool.async([&] {
+                SymbolTable worker_symbols(symbols);
+                for (size_t piece = next_piece++; piece < pieces.size();
+                     piece = next_piece++) {
+                    parse_piece(piece, &worker_symbols);
+                }
+            });
+        }
+        pool.wait();
+    }
+
+    // Stitch the pieces back together in source order, with offsets from
+    // the start of the whole source.
+    ast::CompilationUnit unit;
+    Diagnostics printed;
+    Diagnostics* collected = diagnostics ? diagnostics : &printed;
+    const size_t first = collected->size();
+    for (size_t piece = 0; piece < pieces.size(); ++piece) {
+        unit.Nodes.Adopt(std::move(piece_units[piece].Nodes));
+        unit.Items.insert(unit.Items.end(), piece_units[piece].Items.begin(),
+                          piece_units[piece].Items.end());
+        const size_t piece_offset = pieces[piece].data() - source.data();
+        for (Diagnostic& diagnostic : piece_diagnostics[piece]) {
+            diagnostic.Offset += piece_offset;
+            collected->push_back(std::move(diagnostic));
+        }
+    }
+    FinishDiagnostics(source, collected, first, /*print=*/!diagnostics);
+    return unit;
+}
+}  // namespace parser
+
+namespace
+{
 /// top ::= definition | external | expression
-std::unique_ptr<ast::BaseExpression> ParseNextExpression(Lexer* lexer)
+const ast::BaseExpression* ParseItem(Lexer* lexer, ast::Arena* arena,
+                                     SymbolTable* symbols,
+                                     Diagnostics* diagnostics)
 {
+    llvm::TimeTraceScope scope("ParseItem");
     const tl::expected<Token, LexerError> peek_token = lexer->PeekToken();
+    const ast::BaseExpression* item = nullptr;
     if (!peek_token) {
-        // TODO: Handle error
+        ReportLexerError(lexer, diagnostics, peek_token.error());
+    } else if (peek_token->Type == TokenType::kEof) {
         return nullptr;
+    } else if (peek_token->Type == TokenType::kDef) {
+        item = ParseDefinition(lexer, arena, symbols, diagnostics);
+    } else if (peek_token->Type == TokenType::kExtern) {
+        item = ParseExtern(lexer, arena, symbols, diagnostics);
+    } else {
+        item = ParseExpression(lexer, arena, symbols, diagnostics);
     }
-    const Token& token = peek_token.value();
-    if (token.Type == TokenType::kEof) {
-        return nullptr;
-    } else if (token.Type == TokenType::kDef) {
-        if (auto def = ParseDefinition(lexer)) {
-            return def;
+    if (!item) SkipToNextItem(lexer, diagnostics);
+    return item;
+}
+
+void ParseItems(Lexer* lexer, SymbolTable* symbols,
+                ast::CompilationUnit* unit, Diagnostics* diagnostics)
+{
+    while (true) {
+        const tl::expected<Token, LexerError> peek_token = lexer->PeekToken();
+        if (peek_token && peek_token->Type == TokenType::kEof) return;
+
+        if (auto item = ParseItem(lexer, &unit->Nodes, symbols, diagnostics)) {
+            unit->Items.push_back(item);
         }
-        // Skip token for error recovery.
-        lexer->ConsumeToken();
-        return nullptr;
-    } else if (token.Type == TokenType::kExtern) {
-        if (auto ext = ParseExtern(lexer)) {
-            return ext;
+    }
+}
+
+bool IsIdentifierChar(char c)
+{
+    return scanner::IsInClass(static_cast<unsigned char>(c),
+                              scanner::kAlpha | scanner::kDigit);
+}
+
+// Offset of the first `def` or `extern` keyword at or after `from`, or the
+// size of the source if there is none. Keywords can only start a top-level
+// item, and the language has neither comments nor strings, so matching
+// whole words is enough.
+size_t FindItemStart(std::string_view source, size_t from)
+{
+    for (size_t pos = source.find_first_of("de", from);
+         pos != std::string_view::npos;
+         pos = source.find_first_of("de", pos + 1)) {
+        if (pos > 0 && IsIdentifierChar(source[pos - 1])) continue;
+        for (std::string_view keyword : {"def", "extern"}) {
+            const size_t end = pos + keyword.size();
+            if (source.compare(pos, keyword.size(), keyword) == 0 &&
+                (end == source.size() || !IsIdentifierChar(source[end]))) {
+                return pos;
+            }
         }
-        // Skip token for error recovery.
-        lexer->ConsumeToken();
-        return nullptr;
-    } else if (auto expression = ParseExpression(lexer)) {
-        return expression;
     }
-    // // Skip token for error recovery.
-    lexer->ConsumeToken();
-    return nullptr;
+    return source.size();
 }
-}  // namespace parser
 
-namespace
+// Splits the source into at most `max_pieces` pieces of similar size, each
+// one starting at a top-level item. Pieces smaller than kMinPieceSize are
+// not worth a task.
+std::vector<std::string_view> SplitAtItems(std::string_view source,
+                                           size_t max_pieces)
 {
-std::unique_ptr<ast::BaseExpression> LogError(const std::string& err_str)
+    constexpr size_t kMinPieceSize = 64 * 1024;
+    const size_t piece_count =
+        std::clamp<size_t>(source.size() / kMinPieceSize, 1, max_pieces);
+
+    std::vector<std::string_view> pieces;
+    size_t begin = 0;
+    for (size_t piece = 1; piece <= piece_count && begin < source.size();
+         ++piece) {
+        const size_t target = source.size() / piece_count * piece;
+        const size_t end =
+            piece == piece_count
+                ? source.size()
+                : FindItemStart(source, std::max(target, begin + 1));
+        pieces.push_back(source.substr(begin, end - begin));
+        begin = end;
+    }
+    if (pieces.empty()) pieces.push_back(source);
+    return pieces;
+}
+
+// Records an error at the peeked token. Returns nullptr so that parse
+// functions can return it as their failure.
+std::nullptr_t ReportError(Lexer* lexer, Diagnostics* diagnostics,
+                           DiagnosticCode code, std::string message)
 {
-    std::cerr << "LogError: " << err_str << '\n';
+    Diagnostic& diagnostic = diagnostics->emplace_back();
+    diagnostic.Code = code;
+    diagnostic.Offset = lexer->GetOffset();
+    diagnostic.Message = std::move(message);
     return nullptr;
 }
 
-std::unique_ptr<ast::FnPrototype> LogErrorP(const std::string& err_str)
+std::nullptr_t ReportLexerError(Lexer* lexer, Diagnostics* diagnostics,
+                                const LexerError& error)
 {
-    std::cerr << "LogError: " << err_str << '\n';
-    return nullptr;
+    return ReportError(lexer, diagnostics, DiagnosticCode::kUnknownCharacter,
+                       error.what());
+}
+
+// Skips the rest of an item that failed to parse, up to the next `def` or
+// `extern`, the only tokens sure to start an item. Parsing the pieces of
+// ParseCompilationUnitInParallel resumes at the same places. The skipped
+// tokens may hold more errors, or whole top-level expressions, none of
+// which are checked: a note where they start says how many there are.
+void SkipToNextItem(Lexer* lexer, Diagnostics* diagnostics)
+{
+    const size_t offset = lexer->GetOffset();
+    size_t skipped = 0;
+    while (true) {
+        const tl::expected<Token, LexerError> peek_token = lexer->PeekToken();
+        if (peek_token && (peek_token->Type == TokenType::kEof ||
+                           peek_token->Type == TokenType::kDef ||
+                           peek_token->Type == TokenType::kExtern)) {
+            break;
+        }
+        lexer->ConsumeToken();
+        ++skipped;
+    }
+    if (skipped == 0) return;
+
+    Diagnostic& note = diagnostics->emplace_back();
+    note.Code = DiagnosticCode::kSkippedTokens;
+    note.Severity = DiagnosticSeverity::kNote;
+    note.Offset = offset;
+    note.Message = fmt::format(
+        "Skipped {} {} up to the next def or extern, they were not checked",
+        skipped, skipped == 1 ? "token" : "tokens");
+}
+
+// Locates the diagnostics of one parse, and prints them for callers that
+// did not ask for them.
+void FinishDiagnostics(std::string_view source, Diagnostics* diagnostics,
+                       size_t first, bool print)
+{
+    LocateDiagnostics(source, diagnostics, first);
+    if (!print) return;
+    for (size_t i = first; i < diagnostics->size(); ++i) {
+        std::cerr << FormatDiagnostic((*diagnostics)[i]) << '\n';
+    }
 }
 
+// -1 for tokens that are not binary operators.
 int GetBinOpPrecedence(const Token& token)
 {
     // if (value == '<') return 10;
     if (token.Type == TokenType::kPlusSign) return 20;
     if (token.Type == TokenType::kMinusSign) return 20;
     if (token.Type == TokenType::kAsterisk) return 40;
-    throw std::invalid_argument("Not found");
+    return -1;
 }
 
 bool IsNextTokenBinOp(const Token& token)
@@ -100,144 +334,143 @@ bool IsNextTokenBinOp(const Token& token)
            token.Type == TokenType::kAsterisk;
 }
 
-/// toplevelexpr ::= expression
-std::unique_ptr<ast::Fn> ParseNextTopLevelExpression(Lexer* lexer)
-{
-    if (auto expression = ParseExpression(lexer)) {
-        // Make an anonymous proto.
-        auto proto = std::make_unique<ast::FnPrototype>(
-            "", std::vector<std::string_view>());
-        return std::make_unique<ast::Fn>(std::move(proto),
-                                         std::move(expression));
-    }
-    // Skip token for error recovery.
-    lexer->ConsumeToken();
-    return nullptr;
-}
-
 /// definition ::= 'def' prototype expression
-std::unique_ptr<ast::Fn> ParseDefinition(Lexer* lexer)
+const ast::Fn* ParseDefinition(Lexer* lexer, ast::Arena* arena,
+                               SymbolTable* symbols,
+                               Diagnostics* diagnostics)
 {
     lexer->ConsumeToken();  // eat def.
-    auto proto = ParsePrototype(lexer);
+    auto proto = ParsePrototype(lexer, arena, symbols, diagnostics);
     if (!proto) return nullptr;
 
-    if (auto expression = ParseExpression(lexer))
-        return std::make_unique<ast::Fn>(std::move(proto),
-                                         std::move(expression));
+    if (auto expression = ParseExpression(lexer, arena, symbols, diagnostics))
+        return arena->New<ast::Fn>(proto, expression);
     return nullptr;
 }
 
 /// external ::= 'extern' prototype
-std::unique_ptr<ast::FnPrototype> ParseExtern(Lexer* lexer)
+const ast::FnPrototype* ParseExtern(Lexer* lexer, ast::Arena* arena,
+                                    SymbolTable* symbols,
+                                    Diagnostics* diagnostics)
 {
     lexer->ConsumeToken();  // eat extern.
-    return ParsePrototype(lexer);
+    return ParsePrototype(lexer, arena, symbols, diagnostics);
 }
 
 /// prototype
 ///   ::= id '(' id* ')'
-std::unique_ptr<ast::FnPrototype> ParsePrototype(Lexer* lexer)
+const ast::FnPrototype* ParsePrototype(Lexer* lexer, ast::Arena* arena,
+                                       SymbolTable* symbols,
+                                       Diagnostics* diagnostics)
 {
     tl::expected<Token, LexerError> peek_token = lexer->PeekToken();
     if (!peek_token) {
-        // TODO: Handle error
-        return nullptr;
+        return ReportLexerError(lexer, diagnostics, peek_token.error());
     }
     if (peek_token->Type != TokenType::kIdentifier)
-        return LogErrorP("Expected function name in prototype");
+        return ReportError(lexer, diagnostics,
+                           DiagnosticCode::kExpectedFunctionName,
+                           "Expected function name in prototype");
 
     // Consider wrapping this to catch early bugs
-    const std::string_view fn_name = peek_token->Value;
+    const Symbol fn_name = symbols->Intern(peek_token->Value);
     lexer->ConsumeToken();  // Consume function name
 
     peek_token = lexer->PeekToken();
     if (!peek_token) {
-        // TODO: Handle error
-        return nullptr;
+        return ReportLexerError(lexer, diagnostics, peek_token.error());
     }
     if (peek_token->Type != TokenType::kLeftParen)
-        return LogErrorP("Expected '(' in prototype");
+        return ReportError(lexer, diagnostics,
+                           DiagnosticCode::kExpectedLeftParen,
+                           "Expected '(' in prototype");
 
     lexer->ConsumeToken();  // Consume '('
 
     // Read the list of argument names.
-    std::vector<std::string_view> args_names;
+    std::vector<Symbol> args_names;
     // TODO: Parse this as comma separated identifiers
     while (true) {
         if (const tl::expected<Token, LexerError> arg_token =
                 lexer->PeekToken()) {
             if (arg_token->Type == TokenType::kIdentifier) {
-                args_names.push_back(arg_token->Value);
+                args_names.push_back(symbols->Intern(arg_token->Value));
                 lexer->ConsumeToken();  // Consume identifier
             } else {
                 break;
             }
 
         } else {
-            // TODO: handle error
-            return nullptr;
+            return ReportLexerError(lexer, diagnostics, arg_token.error());
         }
     }
 
     peek_token = lexer->PeekToken();
     if (!peek_token) {
-        // TODO: Handle error
-        return nullptr;
+        return ReportLexerError(lexer, diagnostics, peek_token.error());
     }
     if (peek_token->Type != TokenType::kRightParen)
-        return LogErrorP("Expected ')' in prototype");
+        return ReportError(lexer, diagnostics,
+                           DiagnosticCode::kExpectedRightParen,
+                           "Expected ')' in prototype");
 
     // success.
     lexer->ConsumeToken();  // eat ')'.
 
-    return std::make_unique<ast::FnPrototype>(fn_name, std::move(args_names));
+    return arena->New<ast::FnPrototype>(fn_name,
+                                        arena->CopyArray(args_names));
 }
 
 /// expression
 ///   ::= primary binoprhs
 ///
-std::unique_ptr<ast::BaseExpression> ParseExpression(Lexer* lexer)
+const ast::BaseExpression* ParseExpression(Lexer* lexer, ast::Arena* arena,
+                                           SymbolTable* symbols,
+                                           Diagnostics* diagnostics)
 {
-    auto lhs_op = ParsePrimaryExpression(lexer);
+    auto lhs_op = ParsePrimaryExpression(lexer, arena, symbols, diagnostics);
     if (!lhs_op) return nullptr;
 
-    return ParseBinaryOpRhs(lexer, 0, std::move(lhs_op));
+    return ParseBinaryOpRhs(lexer, arena, symbols, diagnostics, 0, lhs_op);
 }
 
 /// primary
 ///   ::= identifierexpr
 ///   ::= numberexpr
 ///   ::= parenexpr
-std::unique_ptr<ast::BaseExpression> ParsePrimaryExpression(Lexer* lexer)
+const ast::BaseExpression* ParsePrimaryExpression(Lexer* lexer,
+                                                  ast::Arena* arena,
+                                                  SymbolTable* symbols,
+                                                  Diagnostics* diagnostics)
 {
     const tl::expected<Token, LexerError> peek_token = lexer->PeekToken();
     if (!peek_token) {
-        // TODO: Handle error
-        return nullptr;
+        return ReportLexerError(lexer, diagnostics, peek_token.error());
     }
     if (peek_token->Type == TokenType::kIdentifier)
-        return ParseIdentifierExpression(lexer);
+        return ParseIdentifierExpression(lexer, arena, symbols, diagnostics);
     else if (peek_token->Type == TokenType::kNumber)
-        return ParseNumberExpression(lexer);
+        return ParseNumberExpression(lexer, arena, diagnostics);
     else if (peek_token->Type == TokenType::kLeftParen)
-        return ParseParenthesesExpression(lexer);
+        return ParseParenthesesExpression(lexer, arena, symbols, diagnostics);
     else
-        return LogError("Unknown token when expecting an expression");
+        return ReportError(lexer, diagnostics,
+                           DiagnosticCode::kExpectedExpression,
+                           "Expected an expression");
 }
 
 /// binoprhs
 ///   ::= ('+' primary)*
-std::unique_ptr<ast::BaseExpression> ParseBinaryOpRhs(
-    Lexer* lexer, int expression_precedence,
-    std::unique_ptr<ast::BaseExpression> lhs_expression)
+const ast::BaseExpression* ParseBinaryOpRhs(
+    Lexer* lexer, ast::Arena* arena, SymbolTable* symbols,
+    Diagnostics* diagnostics, int expression_precedence,
+    const ast::BaseExpression* lhs_expression)
 {
     // If this is a binop, find its precedence.
     while (true) {
         const tl::expected<Token, LexerError> peek_token = lexer->PeekToken();
         if (!peek_token) {
-            // TODO: Handle error
-            return nullptr;
+            return ReportLexerError(lexer, diagnostics, peek_token.error());
         }
         if (!IsNextTokenBinOp(*peek_token)) return lhs_expression;
         char bin_op = peek_token->Value.front();
@@ -249,7 +482,8 @@ std::unique_ptr<ast::BaseExpression> ParseBinaryOpRhs(
         lexer->ConsumeToken();  // eat binop
 
         // Parse the primary expression after the binary operator.
-        auto rhs_expression = ParsePrimaryExpression(lexer);
+        auto rhs_expression =
+            ParsePrimaryExpression(lexer, arena, symbols, diagnostics);
         if (!rhs_expression) return nullptr;
 
         // If BinOp binds less tightly with RHS than the operator after RHS, let
@@ -257,38 +491,43 @@ std::unique_ptr<ast::BaseExpression> ParseBinaryOpRhs(
         const tl::expected<Token, LexerError> next_peek_token =
             lexer->PeekToken();
         if (!next_peek_token) {
-            // TODO: Handle error
-            return nullptr;
+            return ReportLexerError(lexer, diagnostics,
+                                    next_peek_token.error());
         }
         if (IsNextTokenBinOp(*next_peek_token)) {
             if (curr_token_prec < GetBinOpPrecedence(*next_peek_token)) {
                 rhs_expression =
-                    ParseBinaryOpRhs(lexer, expression_precedence + 1,
-                                     std::move(rhs_expression));
+                    ParseBinaryOpRhs(lexer, arena, symbols, diagnostics,
+                                     expression_precedence + 1,
+                                     rhs_expression);
                 if (!rhs_expression) return nullptr;
             }
         }
 
         // Merge LHS/RHS.
-        lhs_expression = std::make_unique<ast::BinaryOp>(
-            bin_op, std::move(lhs_expression), std::move(rhs_expression));
+        lhs_expression =
+            arena->New<ast::BinaryOp>(bin_op, lhs_expression, rhs_expression);
     }
 }
 
 /// parenexpr ::= '(' expression ')'
-std::unique_ptr<ast::BaseExpression> ParseParenthesesExpression(Lexer* lexer)
+const ast::BaseExpression* ParseParenthesesExpression(Lexer* lexer,
+                                                      ast::Arena* arena,
+                                                      SymbolTable* symbols,
+                                                      Diagnostics* diagnostics)
 {
     lexer->ConsumeToken();  // eat '('
-    auto expression = ParseExpression(lexer);
+    auto expression = ParseExpression(lexer, arena, symbols, diagnostics);
     if (!expression) return nullptr;
 
     const tl::expected<Token, LexerError> peek_token = lexer->PeekToken();
     if (!peek_token) {
-        // TODO: Handle error
-        return nullptr;
+        return ReportLexerError(lexer, diagnostics, peek_token.error());
     }
     if (peek_token->Type != TokenType::kRightParen)
-        return LogError("expected ')'");
+        return ReportError(lexer, diagnostics,
+                           DiagnosticCode::kExpectedRightParen,
+                           "Expected ')'");
     lexer->ConsumeToken();  // eat ')'
     return expression;
 }
@@ -296,50 +535,52 @@ std::unique_ptr<ast::BaseExpression> ParseParenthesesExpression(Lexer* lexer)
 /// identifierexpr
 ///   ::= identifier
 ///   ::= identifier '(' expression* ')'
-std::unique_ptr<ast::BaseExpression> ParseIdentifierExpression(Lexer* lexer)
+const ast::BaseExpression* ParseIdentifierExpression(Lexer* lexer,
+                                                     ast::Arena* arena,
+                                                     SymbolTable* symbols,
+                                                     Diagnostics* diagnostics)
 {
     tl::expected<Token, LexerError> peek_token = lexer->PeekToken();
     if (!peek_token) {
-        // TODO: Handle error
-        return nullptr;
+        return ReportLexerError(lexer, diagnostics, peek_token.error());
     }
-    const std::string_view identifier = peek_token->Value;
+    const Symbol identifier = symbols->Intern(peek_token->Value);
     lexer->ConsumeToken();  // eat identifier
 
     peek_token = lexer->PeekToken();
     if (!peek_token) {
-        // TODO: Handle error
-        return nullptr;
+        return ReportLexerError(lexer, diagnostics, peek_token.error());
     }
     if (peek_token->Type != TokenType::kLeftParen) {
-        return std::make_unique<ast::Variable>(identifier);
+        return arena->New<ast::Variable>(identifier);
     }
 
     // Process fn call
     lexer->ConsumeToken();  // eat '('
-    std::vector<std::unique_ptr<ast::BaseExpression>> fn_args;
+    std::vector<const ast::BaseExpression*> fn_args;
 
     tl::expected<Token, LexerError> arg_token = lexer->PeekToken();
     if (!arg_token) {
-        // TODO: Handle error
-        return nullptr;
+        return ReportLexerError(lexer, diagnostics, arg_token.error());
     }
     if (arg_token->Type != TokenType::kRightParen) {
         while (true) {
-            if (auto arg = ParseExpression(lexer)) {
-                fn_args.push_back(std::move(arg));
+            if (auto arg =
+                    ParseExpression(lexer, arena, symbols, diagnostics)) {
+                fn_args.push_back(arg);
             } else {
                 return nullptr;
             }
 
             arg_token = lexer->PeekToken();
             if (!arg_token) {
-                // TODO: Handle error
-                return nullptr;
+                return ReportLexerError(lexer, diagnostics, arg_token.error());
             }
             if (arg_token->Type == TokenType::kRightParen) break;
             if (arg_token->Type != TokenType::kComma)
-                return LogError("Expected ')' or ',' in argument list");
+                return ReportError(lexer, diagnostics,
+                                   DiagnosticCode::kExpectedCommaOrRightParen,
+                                   "Expected ')' or ',' in argument list");
             lexer->ConsumeToken();
         }
     }
@@ -347,27 +588,29 @@ std::unique_ptr<ast::BaseExpression> ParseIdentifierExpression(Lexer* lexer)
     // Eat ')'.
     lexer->ConsumeToken();
 
-    return std::make_unique<ast::FnCall>(identifier, std::move(fn_args));
+    return arena->New<ast::FnCall>(identifier, arena->CopyArray(fn_args));
 }
 
 /// numberexpr ::= number
-std::unique_ptr<ast::BaseExpression> ParseNumberExpression(Lexer* lexer)
+const ast::BaseExpression* ParseNumberExpression(Lexer* lexer,
+                                                 ast::Arena* arena,
+                                                 Diagnostics* diagnostics)
 {
     const tl::expected<Token, LexerError> peek_token = lexer->PeekToken();
     if (!peek_token) {
-        // TODO: Handle error
-        return nullptr;
+        return ReportLexerError(lexer, diagnostics, peek_token.error());
     }
     const std::string_view value = peek_token->Value;
-    lexer->ConsumeToken();  // eat number
 
     double num_value;
     auto result =
         std::from_chars(value.data(), value.data() + value.size(), num_value);
-    if (result.ec == std::errc::invalid_argument) {
-        return LogError("Could not convert number.");
+    if (result.ec != std::errc()) {
+        return ReportError(lexer, diagnostics, DiagnosticCode::kInvalidNumber,
+                           "Could not convert number");
     }
-    return std::make_unique<ast::Number>(num_value);
+    lexer->ConsumeToken();  // eat number
+    return arena->New<ast::Number>(num_value);
 }
 }  // namespace
 
@@ -0,0 +1,191 @@
+#include "kaleidoscope/simplifier.h"
+
+#include "kaleidoscope/ast/binary_op.h"
+#include "kaleidoscope/ast/fn.h"
+#include "kaleidoscope/ast/fn_call.h"
+#include "kaleidoscope/ast/number.h"
+
+#include <llvm/Support/TimeProfiler.h>
+
+#include <cmath>
+#include <vector>
+
+namespace kaleidoscope
+{
+
+namespace
+{
+size_t GetChildCount(const ast::BaseExpression* expression)
+{
+    switch (expression->GetKind()) {
+        case ast::ExpressionKind::kBinaryOp:
+            return 2;
+        case ast::ExpressionKind::kFnCall:
+            return ast::cast<ast::FnCall>(expression)->Args.size();
+        case ast::ExpressionKind::kFn:
+            return 1;
+        case ast::ExpressionKind::kNumber:
+        case ast::ExpressionKind::kVariable:
+        case ast::ExpressionKind::kFnPrototype:
+            break;
+    }
+    return 0;
+}
+
+const ast::BaseExpression* GetChild(const ast::BaseExpression* expression,
+                                    size_t index)
+{
+    switch (expression->GetKind()) {
+        case ast::ExpressionKind::kBinaryOp: {
+            const auto* bin_op = ast::cast<ast::BinaryOp>(expression);
+            return index == 0 ? bin_op->LhsOp : bin_op->RhsOp;
+        }
+        case ast::ExpressionKind::kFnCall:
+            return ast::cast<ast::FnCall>(expression)->Args[index];
+        case ast::ExpressionKind::kFn:
+            return ast::cast<ast::Fn>(expression)->Body;
+        case ast::ExpressionKind::kNumber:
+        case ast::ExpressionKind::kVariable:
+        case ast::ExpressionKind::kFnPrototype:
+            break;
+    }
+    return nullptr;
+}
+
+bool IsLiteral(const ast::BaseExpression* expression, double value)
+{
+    const auto* number = ast::dyn_cast<ast::Number>(expression);
+    return number && number->Value == value &&
+           std::signbit(number->Value) == std::signbit(value);
+}
+
+// Returns nullptr when the operation has to be kept.
+const ast::BaseExpression* FoldBinaryOp(char op,
+                                        const ast::BaseExpression* lhs,
+                                        const ast::BaseExpression* rhs,
+                                        ast::Arena* arena)
+{
+    const auto* lhs_number = ast::dyn_cast<ast::Number>(lhs);
+    const auto* rhs_number = ast::dyn_cast<ast::Number>(rhs);
+    if (lhs_number && rhs_number) {
+        // Same double arithmetic as the generated code.
+        switch (op) {
+            case '+':
+                return arena->New<ast::Number>(lhs_number->Value +
+                                               rhs_number->Value);
+            case '-':
+                return arena->New<ast::Number>(lhs_number->Value -
+                                               rhs_number->Value);
+            case '*':
+                return arena->New<ast::Number>(lhs_number->Value *
+                                               rhs_number->Value);
+            default:
+                return nullptr;
+        }
+    }
+
+    switch (op) {
+        case '+':
+            if (IsLiteral(rhs, -0.0)) return lhs;
+            if (IsLiteral(lhs, -0.0)) return rhs;
+            break;
+        case '-':
+            if (IsLiteral(rhs, 0.0)) return lhs;
+            break;
+        case '*':
+            if (IsLiteral(rhs, 1.0)) return lhs;
+            if (IsLiteral(lhs, 1.0)) return rhs;
+            break;
+    }
+    return nullptr;
+}
+
+// Builds `expression` again over its simplified children, or returns it
+// as is if none of them changed.
+const ast::BaseExpression* Rebuild(const ast::BaseExpression* expression,
+                                   const ast::BaseExpression* const* children,
+                                   ast::Arena* arena)
+{
+    switch (expression->GetKind()) {
+        case ast::ExpressionKind::kBinaryOp: {
+            const auto* bin_op = ast::cast<ast::BinaryOp>(expression);
+            if (const auto* folded =
+                    FoldBinaryOp(bin_op->Op, children[0], children[1], arena)) {
+                return folded;
+            }
+            if (children[0] == bin_op->LhsOp && children[1] == bin_op->RhsOp) {
+                return bin_op;
+            }
+            return arena->New<ast::BinaryOp>(bin_op->Op, children[0],
+                                             children[1]);
+        }
+        case ast::ExpressionKind::kFnCall: {
+            const auto* fn_call = ast::cast<ast::FnCall>(expression);
+            const size_t arg_count = fn_call->Args.size();
+            std::vector<const ast::BaseExpression*> args(children,
+                                                         children + arg_count);
+            bool changed = false;
+            for (size_t i = 0; i < arg_count; ++i) {
+                changed |= args[i] != fn_call->Args[i];
+            }
+            if (!changed) return fn_call;
+            return arena->New<ast::FnCall>(fn_call->Callee,
+                                           arena->CopyArray(args));
+        }
+        case ast::ExpressionKind::kFn: {
+            const auto* fn = ast::cast<ast::Fn>(expression);
+            if (children[0] == fn->Body) return fn;
+            return arena->New<ast::Fn>(fn->Proto, children[0]);
+        }
+        case ast::ExpressionKind::kNumber:
+        case ast::ExpressionKind::kVariable:
+        case ast::ExpressionKind::kFnPrototype:
+            break;
+    }
+    return expression;
+}
+}  // namespace
+
+namespace simplifier
+{
+const ast::BaseExpression* SimplifyExpression(
+    const ast::BaseExpression* expression, ast::Arena* arena)
+{
+    // Generated sources chain thousands of operations into a single tree,
+    // so it is walked with explicit stacks rather than recursion. Children
+    // are visited first and their results are pushed to `simplified`, in
+    // order, until their parent is rebuilt over them.
+    struct PendingNode {
+        const ast::BaseExpression* Node;
+        size_t NextChild;
+    };
+    std::vector<PendingNode> pending = {{expression, 0}};
+    std::vector<const ast::BaseExpression*> simplified;
+    while (!pending.empty()) {
+        const ast::BaseExpression* node = pending.back().Node;
+        const size_t child_count = GetChildCount(node);
+        const size_t next_child = pending.back().NextChild++;
+        if (next_child < child_count) {
+            pending.push_back({GetChild(node, next_child), 0});
+            continue;
+        }
+        pending.pop_back();
+
+        const size_t first_child = simplified.size() - child_count;
+        const ast::BaseExpression* result =
+            Rebuild(node, simplified.data() + first_child, arena);
+        simplified.resize(first_child);
+        simplified.push_back(result);
+    }
+    return simplified.back();
+}
+
+void SimplifyCompilationUnit(ast::CompilationUnit* unit)
+{
+    llvm::TimeTraceScope scope("Simplify");
+    for (const ast::BaseExpression*& item : unit->Items) {
+        item = SimplifyExpression(item, &unit->Nodes);
+    }
+}
+}  // namespace simplifier
+}  // namespace kaleidoscope
@@ -0,0 +1,130 @@
+#include "kaleidoscope/source_buffer.h"
+
+#include <cerrno>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <utility>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace kaleidoscope
+{
+
+namespace
+{
+std::string ReadStream(std::istream& stream)
+{
+    return std::string(std::istreambuf_iterator<char>(stream),
+                       std::istreambuf_iterator<char>());
+}
+}  // namespace
+
+SourceBuffer::SourceBuffer(std::string contents) : owned_(std::move(contents))
+{
+}
+
+SourceBuffer::SourceBuffer(const char* mapped, size_t size)
+    : mapped_(mapped), mapped_size_(size)
+{
+}
+
+SourceBuffer::SourceBuffer(SourceBuffer&& other) noexcept
+    : owned_(std::move(other.owned_)),
+      borrowed_(std::exchange(other.borrowed_, std::string_view())),
+      mapped_(std::exchange(other.mapped_, nullptr)),
+      mapped_size_(std::exchange(other.mapped_size_, 0))
+{
+}
+
+SourceBuffer& SourceBuffer::operator=(SourceBuffer&& other) noexcept
+{
+    if (this != &other) {
+        Release();
+        owned_ = std::move(other.owned_);
+        borrowed_ = std::exchange(other.borrowed_, std::string_view());
+        mapped_ = std::exchange(other.mapped_, nullptr);
+        mapped_size_ = std::exchange(other.mapped_size_, 0);
+    }
+    return *this;
+}
+
+SourceBuffer::~SourceBuffer() { Release(); }
+
+void SourceBuffer::Release()
+{
+#if !defined(_WIN32)
+    if (mapped_) {
+        munmap(const_cast<char*>(mapped_), mapped_size_);
+    }
+#endif
+    mapped_ = nullptr;
+    mapped_size_ = 0;
+}
+
+tl::expected<SourceBuffer, std::error_code> SourceBuffer::FromFile(
+    const std::string& path)
+{
+    if (path == "-") return SourceBuffer(ReadStream(std::cin));
+
+#if !defined(_WIN32)
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return tl::unexpected(std::error_code(errno, std::generic_category()));
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == 0 && S_ISREG(file_stat.st_mode) &&
+        file_stat.st_size > 0) {
+        const size_t size = static_cast<size_t>(file_stat.st_size);
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        const int map_error = errno;
+        // The mapping keeps its own reference to the file.
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            return tl::unexpected(
+                std::error_code(map_error, std::generic_category()));
+        }
+        // The lexer makes a single forward pass over the source.
+        madvise(mapped, size, MADV_SEQUENTIAL);
+        return SourceBuffer(static_cast<const char*>(mapped), size);
+    }
+    close(fd);
+#endif
+
+    // Empty files and anything that is not a regular file.
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return tl::unexpected(
+            std::make_error_code(std::errc::no_such_file_or_directory));
+    }
+    return SourceBuffer(ReadStream(file));
+}
+
+SourceBuffer SourceBuffer::FromString(std::string contents)
+{
+    return SourceBuffer(std::move(contents));
+}
+
+SourceBuffer SourceBuffer::FromView(std::string_view contents)
+{
+    SourceBuffer buffer{std::string()};
+    buffer.borrowed_ = contents;
+    return buffer;
+}
+
+std::string_view SourceBuffer::Contents() const
+{
+    if (mapped_) return std::string_view(mapped_, mapped_size_);
+    if (borrowed_.data()) return borrowed_;
+    return owned_;
+}
+
+bool SourceBuffer::IsMapped() const { return mapped_ != nullptr; }
+
+}  // namespace kaleidoscope
@@ -0,0 +1,55 @@
+#include "kaleidoscope/symbol_table.h"
+
+namespace kaleidoscope
+{
+
+SymbolTable::SymbolTable() = default;
+
+SymbolTable::SymbolTable(SymbolTable* shared) : shared_(shared) {}
+
+SymbolTable::~SymbolTable() = default;
+
+Symbol SymbolTable::Intern(std::string_view spelling)
+{
+    if (auto it = index_.find(spelling); it != index_.end()) {
+        return Symbol(it->second);
+    }
+
+    if (shared_) {
+        // Cache the symbol under the shared table's copy of the spelling.
+        const Symbol symbol = shared_->InternShared(spelling);
+        index_.emplace(symbol.GetSpelling(), symbol.entry_);
+        return symbol;
+    }
+
+    const std::string_view stored = spellings_.emplace_back(spelling);
+    const Symbol::Entry& entry = entries_.emplace_back(
+        Symbol::Entry{stored, static_cast<uint32_t>(entries_.size())});
+    index_.emplace(stored, &entry);
+    return Symbol(&entry);
+}
+
+Symbol SymbolTable::InternShared(std::string_view spelling)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return Intern(spelling);
+}
+
+Symbol SymbolTable::Find(std::string_view spelling) const
+{
+    if (auto it = index_.find(spelling); it != index_.end()) {
+        return Symbol(it->second);
+    }
+    if (!shared_) return Symbol();
+    std::lock_guard<std::mutex> lock(shared_->mutex_);
+    return shared_->Find(spelling);
+}
+
+size_t SymbolTable::GetSymbolCount() const
+{
+    if (!shared_) return entries_.size();
+    std::lock_guard<std::mutex> lock(shared_->mutex_);
+    return shared_->GetSymbolCount();
+}
+
+}  // namespace kaleidoscope
@@ -0,0 +1,32 @@
+#include "kaleidoscope/time_trace.h"
+
+#include <llvm/Support/Error.h>
+#include <llvm/Support/TimeProfiler.h>
+
+#include <iostream>
+
+namespace kaleidoscope
+{
+
+namespace time_trace
+{
+void Begin(unsigned granularity_us)
+{
+    llvm::timeTraceProfilerInitialize(granularity_us, "kaleidoscope");
+}
+
+bool Finish(const std::string& path)
+{
+    if (!llvm::timeTraceProfilerEnabled()) return false;
+
+    llvm::Error err = llvm::timeTraceProfilerWrite(path, path);
+    llvm::timeTraceProfilerCleanup();
+    if (err) {
+        std::cerr << "Could not write time trace: "
+                  << llvm::toString(std::move(err)) << '\n';
+        return false;
+    }
+    return true;
+}
+}  // namespace time_trace
+}  // namespace kaleidoscope
@@ -0,0 +1,320 @@
+#include "kaleidoscope/vm_interpreter.h"
+
+#include "kaleidoscope/ast/base_expression.h"
+#include "kaleidoscope/ast/compilation_unit.h"
+#include "kaleidoscope/ast/fn.h"
+#include "kaleidoscope/ast/fn_prototype.h"
+
+#include <llvm/Support/DynamicLibrary.h>
+#include <llvm/Support/TimeProfiler.h>
+
+#include <iostream>
+#include <string>
+#include <unordered_set>
+
+namespace kaleidoscope
+{
+
+namespace
+{
+// Without branches, only runaway recursion gets this deep.
+constexpr size_t kMaxCallDepth = 1 << 16;
+
+// Host functions are called through a pointer of their exact type, one per
+// supported arity.
+constexpr size_t kMaxHostArity = 6;
+
+double CallHost(void* entry, size_t arity, const double* args)
+{
+    switch (arity) {
+        case 0:
+            return reinterpret_cast<double (*)()>(entry)();
+        case 1:
+            return reinterpret_cast<double (*)(double)>(entry)(args[0]);
+        case 2:
+            return reinterpret_cast<double (*)(double, double)>(entry)(
+                args[0], args[1]);
+        case 3:
+            return reinterpret_cast<double (*)(double, double, double)>(
+                entry)(args[0], args[1], args[2]);
+        case 4:
+            return reinterpret_cast<double (*)(double, double, double,
+                                               double)>(entry)(
+                args[0], args[1], args[2], args[3]);
+        case 5:
+            return reinterpret_cast<double (*)(double, double, double, double,
+                                               double)>(entry)(
+                args[0], args[1], args[2], args[3], args[4]);
+        case 6:
+            return reinterpret_cast<double (*)(double, double, double, double,
+                                               double, double)>(entry)(
+                args[0], args[1], args[2], args[3], args[4], args[5]);
+    }
+    return 0;
+}
+
+uint32_t GetWideOperand(const bytecode::Instruction& instruction)
+{
+    return instruction.B | uint32_t{instruction.C} << 16;
+}
+}  // namespace
+
+VmInterpreter::VmInterpreter()
+{
+    // Externs resolve against the symbols of the host process.
+    llvm::sys::DynamicLibrary::LoadLibraryPermanently(nullptr);
+}
+
+VmInterpreter::~VmInterpreter() = default;
+
+void VmInterpreter::DeclareExtern(const ast::FnPrototype* extern_call)
+{
+    const Symbol name = extern_call->Name;
+    if (function_indices_.Contains(name)) return;
+    if (extern_call->Args.size() > kMaxHostArity) {
+        std::cerr << "Externs take at most " << kMaxHostArity
+                  << " arguments\n";
+        return;
+    }
+    const std::string spelling(name.GetSpelling());
+    void* entry = llvm::sys::DynamicLibrary::SearchForAddressOfSymbol(spelling);
+    if (!entry) {
+        std::cerr << "Unknown host function " << spelling << '\n';
+        return;
+    }
+
+    bytecode::Function function;
+    function.Arity = extern_call->Args.size();
+    function.HostEntry = entry;
+    function_indices_.Set(name, static_cast<uint32_t>(functions_.size()));
+    functions_.push_back(std::move(function));
+}
+
+bool VmInterpreter::DeclareDefinition(const ast::Fn* definition)
+{
+    const Symbol name = definition->Proto->Name;
+    if (function_indices_.Contains(name)) {
+        std::cerr << "Function " << name.GetSpelling()
+                  << " cannot be redefined\n";
+        return false;
+    }
+    bytecode::Function function;
+    function.Arity = definition->Proto->Args.size();
+    function_indices_.Set(name, static_cast<uint32_t>(functions_.size()));
+    functions_.push_back(std::move(function));
+    return true;
+}
+
+void VmInterpreter::AddDefinitions(
+    const std::vector<const ast::Fn*>& definitions)
+{
+    llvm::TimeTraceScope scope("CompileBytecode");
+    std::unordered_set<uint32_t> broken;
+    for (const ast::Fn* definition : definitions) {
+        const uint32_t index = *function_indices_.Find(definition->Proto->Name);
+        if (!bytecode::CompileFunction(definition->Proto->Args,
+                                       definition->Body, function_indices_,
+                                       functions_, &functions_[index])) {
+            broken.insert(index);
+        }
+    }
+
+    // Callers of broken functions are broken as well. Functions of earlier
+    // items cannot call these, they were compiled before they existed.
+    for (bool changed = !broken.empty(); changed;) {
+        changed = false;
+        for (const ast::Fn* definition : definitions) {
+            const uint32_t index =
+                *function_indices_.Find(definition->Proto->Name);
+            if (broken.count(index)) continue;
+            for (uint32_t callee : bytecode::GetCallees(functions_[index])) {
+                if (broken.count(callee)) {
+                    broken.insert(index);
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    // Forget them, so they can be defined again.
+    for (const ast::Fn* definition : definitions) {
+        const Symbol name = definition->Proto->Name;
+        const uint32_t index = *function_indices_.Find(name);
+        if (broken.count(index)) {
+            function_indices_.Erase(name);
+            functions_[index] = bytecode::Function();
+        }
+    }
+}
+
+std::optional<double> VmInterpreter::RunExpression(
+    const ast::BaseExpression* expression)
+{
+    bytecode::Function anonymous;
+    if (!bytecode::CompileFunction({}, expression, function_indices_,
+                                   functions_, &anonymous)) {
+        return std::nullopt;
+    }
+    llvm::TimeTraceScope scope("Run");
+    return Run(anonymous);
+}
+
+std::optional<double> VmInterpreter::Run(const bytecode::Function& entry)
+{
+    struct Frame {
+        const bytecode::Function* Function;
+        const bytecode::Instruction* ReturnAddress;
+        size_t Base;
+    };
+    std::vector<Frame> frames;
+
+    const bytecode::Function* function = &entry;
+    const bytecode::Instruction* pc = entry.Code.data();
+    const bytecode::Instruction* instruction = nullptr;
+    size_t base = 0;
+    if (stack_.size() < entry.RegisterCount) stack_.resize(entry.RegisterCount);
+    double* registers = stack_.data();
+
+#if defined(__GNUC__)
+    // Threaded dispatch: every handler ends in its own indirect jump to the
+    // next one, which predicts far better than the single jump of a switch.
+    // Labels are in Opcode order.
+    static const void* const kHandlers[] = {
+        &&load_constant, &&move, &&add, &&sub, &&mul, &&call, &&return_,
+    };
+#define KALEIDOSCOPE_VM_DISPATCH() \
+    instruction = pc++;            \
+    goto* kHandlers[static_cast<size_t>(instruction->Op)]
+#define KALEIDOSCOPE_VM_HANDLER(label, opcode) label:
+    KALEIDOSCOPE_VM_DISPATCH();
+#else
+#define KALEIDOSCOPE_VM_DISPATCH() goto dispatch
+#define KALEIDOSCOPE_VM_HANDLER(label, opcode) case bytecode::Opcode::opcode:
+dispatch:
+    instruction = pc++;
+    switch (instruction->Op) {
+#endif
+    KALEIDOSCOPE_VM_HANDLER(load_constant, kLoadConstant)
+    registers[instruction->A] =
+        function->Constants[GetWideOperand(*instruction)];
+    KALEIDOSCOPE_VM_DISPATCH();
+
+    KALEIDOSCOPE_VM_HANDLER(move, kMove)
+    registers[instruction->A] = registers[instruction->B];
+    KALEIDOSCOPE_VM_DISPATCH();
+
+    KALEIDOSCOPE_VM_HANDLER(add, kAdd)
+    registers[instruction->A] =
+        registers[instruction->B] + registers[instruction->C];
+    KALEIDOSCOPE_VM_DISPATCH();
+
+    KALEIDOSCOPE_VM_HANDLER(sub, kSub)
+    registers[instruction->A] =
+        registers[instruction->B] - registers[instruction->C];
+    KALEIDOSCOPE_VM_DISPATCH();
+
+    KALEIDOSCOPE_VM_HANDLER(mul, kMul)
+    registers[instruction->A] =
+        registers[instruction->B] * registers[instruction->C];
+    KALEIDOSCOPE_VM_DISPATCH();
+
+    KALEIDOSCOPE_VM_HANDLER(call, kCall)
+    {
+        const bytecode::Function& callee =
+            functions_[GetWideOperand(*instruction)];
+        if (callee.HostEntry) {
+            registers[instruction->A] =
+                CallHost(callee.HostEntry, callee.Arity,
+                         registers + instruction->A);
+            KALEIDOSCOPE_VM_DISPATCH();
+        }
+        if (frames.size() == kMaxCallDepth) {
+            std::cerr << "Stack overflow\n";
+            return std::nullopt;
+        }
+
+        // The callee's frame starts at the arguments.
+        frames.push_back({function, pc, base});
+        base += instruction->A;
+        if (stack_.size() < base + callee.RegisterCount) {
+            stack_.resize(base + callee.RegisterCount);
+        }
+        registers = stack_.data() + base;
+        function = &callee;
+        pc = callee.Code.data();
+        KALEIDOSCOPE_VM_DISPATCH();
+    }
+
+    KALEIDOSCOPE_VM_HANDLER(return_, kReturn)
+    {
+        const double result = registers[instruction->A];
+        if (frames.empty()) return result;
+        // R[0] of this frame is where the caller expects the result.
+        registers[0] = result;
+        const Frame& caller = frames.back();
+        function = caller.Function;
+        pc = caller.ReturnAddress;
+        base = caller.Base;
+        frames.pop_back();
+        registers = stack_.data() + base;
+        KALEIDOSCOPE_VM_DISPATCH();
+    }
+#if !defined(__GNUC__)
+    }
+#endif
+#undef KALEIDOSCOPE_VM_DISPATCH
+#undef KALEIDOSCOPE_VM_HANDLER
+    return std::nullopt;
+}
+
+std::optional<double> VmInterpreter::EvaluateExpression(
+    const ast::BaseExpression* expression)
+{
+    llvm::TimeTraceScope scope("EvaluateExpression");
+    if (const ast::FnPrototype* extern_call =
+            ast::dyn_cast<ast::FnPrototype>(expression)) {
+        DeclareExtern(extern_call);
+        return std::nullopt;
+    }
+    if (const ast::Fn* definition = ast::dyn_cast<ast::Fn>(expression)) {
+        // Declare it first, the body may call itself.
+        if (DeclareDefinition(definition)) AddDefinitions({definition});
+        return std::nullopt;
+    }
+    return RunExpression(expression);
+}
+
+std::vector<std::optional<double>> VmInterpreter::EvaluateUnit(
+    const ast::CompilationUnit& unit)
+{
+    llvm::TimeTraceScope scope("EvaluateUnit");
+    // Declare every item up front, so that any item can refer to functions
+    // defined later in the unit.
+    std::vector<const ast::Fn*> definitions;
+    std::vector<const ast::BaseExpression*> expressions;
+    for (const ast::BaseExpression* item : unit.Items) {
+        if (const ast::FnPrototype* extern_call =
+                ast::dyn_cast<ast::FnPrototype>(item)) {
+            DeclareExtern(extern_call);
+        } else if (const ast::Fn* definition =
+                       ast::dyn_cast<ast::Fn>(item)) {
+            if (DeclareDefinition(definition)) {
+                definitions.push_back(definition);
+            }
+        } else {
+            expressions.push_back(item);
+        }
+    }
+    AddDefinitions(definitions);
+
+    std::vector<std::optional<double>> results;
+    for (const ast::BaseExpression* expression : expressions) {
+        results.push_back(RunExpression(expression));
+    }
+    return results;
+}
+
+SymbolTable& VmInterpreter::GetSymbolTable() { return symbols_; }
+
+}  // namespace kaleidoscope
@@ -0,0 +1,104 @@
+#include "kaleidoscope/aot_compiler.h"
+
+#include "kaleidoscope/ast/compilation_unit.h"
+#include "kaleidoscope/lexer_impl.h"
+#include "kaleidoscope/parser.h"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+using kaleidoscope::AotCompiler;
+using kaleidoscope::LexerImpl;
+using kaleidoscope::parser::ParseCompilationUnit;
+
+namespace
+{
+bool AddSource(AotCompiler &compiler, const char *source)
+{
+    LexerImpl lexer{std::string(source)};
+    return compiler.AddUnit(
+        ParseCompilationUnit(&lexer, &compiler.GetSymbolTable()));
+}
+
+std::string ReadFile(const std::filesystem::path &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), {});
+}
+}  // namespace
+
+class AotCompilerTest : public ::testing::Test
+{
+   protected:
+    void SetUp() override
+    {
+        output_dir_ =
+            std::filesystem::temp_directory_path() /
+            ::testing::UnitTest::GetInstance()->current_test_info()->name();
+        std::filesystem::remove_all(output_dir_);
+        std::filesystem::create_directories(output_dir_);
+    }
+
+    void TearDown() override { std::filesystem::remove_all(output_dir_); }
+
+    std::filesystem::path output_dir_;
+    AotCompiler compiler_;
+};
+
+TEST_F(AotCompilerTest, WriteLibrary)
+{
+    // Definitions may call each other in any order, across units.
+    EXPECT_TRUE(AddSource(compiler_,
+                          "extern fabs(x) def dist(a b) fabs(a - b) + sq(a) "
+                          "def sq(x) x * x"));
+    EXPECT_TRUE(AddSource(compiler_, "def one() sq(1)"));
+
+    const std::filesystem::path object = output_dir_ / "formulas.o";
+    const std::filesystem::path archive = output_dir_ / "libformulas.a";
+    const std::filesystem::path header = output_dir_ / "formulas.h";
+    ASSERT_TRUE(compiler_.WriteObject(object.string()));
+    ASSERT_TRUE(compiler_.WriteArchive(archive.string()));
+    ASSERT_TRUE(compiler_.WriteHeader(header.string()));
+
+    const std::string object_contents = ReadFile(object);
+    EXPECT_FALSE(object_contents.empty());
+    const std::string archive_contents = ReadFile(archive);
+    EXPECT_EQ(0u, archive_contents.rfind("!<arch>\n", 0));
+    EXPECT_NE(std::string::npos, archive_contents.find(object_contents));
+
+    const std::string header_contents = ReadFile(header);
+    EXPECT_NE(std::string::npos, header_contents.find("#ifndef FORMULAS_H"));
+    EXPECT_NE(std::string::npos, header_contents.find("extern \"C\" {"));
+    EXPECT_NE(std::string::npos,
+              header_contents.find("double dist(double, double);\n"
+                                   "double sq(double);\n"
+                                   "double one(void);\n"));
+    // Externs belong to whatever the library is linked with.
+    EXPECT_EQ(std::string::npos, header_contents.find("fabs"));
+
+    // The library is final once compiled.
+    EXPECT_FALSE(AddSource(compiler_, "def two() 2"));
+}
+
+TEST_F(AotCompilerTest, LeaveOutBrokenDefinitions)
+{
+    EXPECT_FALSE(AddSource(compiler_,
+                           "def ok(x) x + 1 def broken(x) y "
+                           "def caller(x) broken(x) 1 + 2 def ok(x) x"));
+    // Broken definitions can be fixed by a later unit.
+    EXPECT_TRUE(AddSource(compiler_, "def broken(x) x"));
+
+    const std::filesystem::path header = output_dir_ / "2broken.h";
+    ASSERT_TRUE(compiler_.WriteHeader(header.string()));
+    const std::string header_contents = ReadFile(header);
+    EXPECT_NE(std::string::npos, header_contents.find("#ifndef KS_2BROKEN_H"));
+    EXPECT_NE(std::string::npos,
+              header_contents.find("double ok(double);\n"
+                                   "double broken(double);\n"));
+    EXPECT_EQ(std::string::npos, header_contents.find("caller"));
+    EXPECT_TRUE(compiler_.WriteObject((output_dir_ / "2broken.o").string()));
+}
@@ -0,0 +1,646 @@
+#include "kaleidoscope/jit_interpreter.h"
+
+#include "kaleidoscope/ast/arena.h"
+#include "kaleidoscope/ast/base_expression.h"
+#include "kaleidoscope/ast/compilation_unit.h"
+#include "kaleidoscope/lexer_impl.h"
+#include "kaleidoscope/parser.h"
+#include "kaleidoscope/time_trace.h"
+
+#include <fmt/core.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using kaleidoscope::FastMathFlags;
+using kaleidoscope::JitInterpreter;
+using kaleidoscope::JitOptions;
+using kaleidoscope::LexerImpl;
+using kaleidoscope::MemoStats;
+using kaleidoscope::ObjectCacheStats;
+using kaleidoscope::OptimizationLevel;
+using kaleidoscope::TierStats;
+using kaleidoscope::ast::Arena;
+using kaleidoscope::ast::BaseExpression;
+using kaleidoscope::ast::CompilationUnit;
+using kaleidoscope::parser::ParseCompilationUnit;
+using kaleidoscope::parser::ParseNextExpression;
+
+namespace
+{
+std::optional<double> Evaluate(JitInterpreter &interpreter, const char *input)
+{
+    LexerImpl lexer{std::string(input)};
+    Arena arena;
+    const BaseExpression* expr =
+        ParseNextExpression(&lexer, &arena, &interpreter.GetSymbolTable());
+    if (!expr) return std::nullopt;
+    return interpreter.EvaluateExpression(expr);
+}
+}  // namespace
+
+class JitInterpreterTest : public ::testing::Test
+{
+   protected:
+    JitInterpreter interpreter_;
+};
+
+TEST_F(JitInterpreterTest, EvaluateTopLevelExpression)
+{
+    EXPECT_EQ(std::optional<double>(7), Evaluate(interpreter_, "1 + 2 * 3"));
+    EXPECT_EQ(std::optional<double>(-4), Evaluate(interpreter_, "(1 - 5)"));
+}
+
+TEST_F(JitInterpreterTest, CallDefinedFunction)
+{
+    EXPECT_EQ(std::nullopt, Evaluate(interpreter_, "def sq(x) x * x"));
+    EXPECT_EQ(std::nullopt, Evaluate(interpreter_, "def add(a b) a + sq(b)"));
+    EXPECT_EQ(std::optional<double>(11), Evaluate(interpreter_, "add(2, 3)"));
+}
+
+TEST_F(JitInterpreterTest, CallHostFunction)
+{
+    EXPECT_EQ(std::nullopt, Evaluate(interpreter_, "extern fabs(x)"));
+    EXPECT_EQ(std::optional<double>(3), Evaluate(interpreter_, "fabs(1 - 4)"));
+}
+
+TEST_F(JitInterpreterTest, EvaluateUnit)
+{
+    LexerImpl lexer(std::string(
+        "def a(x) b(x) * 2 "
+        "a(1) "
+        "def b(x) x + c "
+        "def c(x) x + 1 "
+        "a(2) + b(3)"));
+    const CompilationUnit unit =
+        ParseCompilationUnit(&lexer, &interpreter_.GetSymbolTable());
+    ASSERT_EQ(5u, unit.Items.size());
+
+    // `b` refers to an unknown variable, everything that depends on it fails
+    // to compile, the expressions are still evaluated in source order.
+    const std::vector<std::optional<double>> results =
+        interpreter_.EvaluateUnit(unit);
+    ASSERT_EQ(2u, results.size());
+    EXPECT_EQ(std::nullopt, results[0]);
+    EXPECT_EQ(std::nullopt, results[1]);
+    EXPECT_EQ(std::optional<double>(3), Evaluate(interpreter_, "c(2)"));
+
+    LexerImpl forward_lexer(std::string(
+        "def d(x) e(x) * 2 d(1) def e(x) x + 1 d(2) + e(3)"));
+    const std::vector<std::optional<double>> forward_results =
+        interpreter_.EvaluateUnit(ParseCompilationUnit(&forward_lexer,
+                             &interpreter_.GetSymbolTable()));
+    ASSERT_EQ(2u, forward_results.size());
+    EXPECT_EQ(std::optional<double>(4), forward_results[0]);
+    EXPECT_EQ(std::optional<double>(10), forward_results[1]);
+}
+
+TEST_F(JitInterpreterTest, ReportErrors)
+{
+    EXPECT_EQ(std::nullopt, Evaluate(interpreter_, "undefined(1)"));
+    EXPECT_EQ(std::nullopt, Evaluate(interpreter_, "def bad(x) y"));
+    EXPECT_EQ(std::nullopt, Evaluate(interpreter_, "bad(1)"));
+    // The interpreter is still usable after errors.
+    EXPECT_EQ(std::optional<double>(2), Evaluate(interpreter_, "1 + 1"));
+}
+
+TEST_F(JitInterpreterTest, ParallelCompilation)
+{
+    JitOptions options;
+    options.OptLevel = OptimizationLevel::kO2;
+    options.CompileThreads = 4;
+    JitInterpreter parallel(options);
+
+    // Eight definitions, two per module. Calls go across modules in both
+    // directions, and `bad` breaks callers in modules other than its own.
+    LexerImpl lexer(std::string(
+        "def p0(x) x + 1 "
+        "def bad(x) y "
+        "def p1(x) p0(x) * 2 "
+        "def p2(x) p7(x) + 1 "
+        "def usesbad(x) bad(x) "
+        "def p3(x) p2(x) + p1(x) "
+        "def indirect(x) usesbad(x) + 1 "
+        "def p7(x) x * 10 "
+        "p3(1) "
+        "indirect(1)"));
+    const std::vector<std::optional<double>> results = parallel.EvaluateUnit(
+        ParseCompilationUnit(&lexer, &parallel.GetSymbolTable()));
+    ASSERT_EQ(2u, results.size());
+    EXPECT_EQ(std::optional<double>(15), results[0]);
+    EXPECT_EQ(std::nullopt, results[1]);
+
+    EXPECT_EQ(std::optional<double>(6), Evaluate(parallel, "p0(5)"));
+    // Broken functions, and their callers, can be defined again.
+    EXPECT_EQ(std::nullopt, Evaluate(parallel, "def usesbad(x) x - 1"));
+    EXPECT_EQ(std::optional<double>(4), Evaluate(parallel, "usesbad(5)"));
+}
+
+TEST_F(JitInterpreterTest, OptimizationLevelsAgree)
+{
+    for (OptimizationLevel level :
+         {OptimizationLevel::kO1, OptimizationLevel::kO2,
+          OptimizationLevel::kO3}) {
+        JitOptions options;
+        options.OptLevel = level;
+        JitInterpreter optimized(options);
+        EXPECT_EQ(std::nullopt,
+                  Evaluate(optimized, "def f(x y) (x + 1) * (y - 2) * x"));
+        EXPECT_EQ(std::optional<double>(30), Evaluate(optimized, "f(2, 7)"))
+            << OptimizationLevelToString(level);
+    }
+}
+
+TEST_F(JitInterpreterTest, LazyCompilation)
+{
+    JitOptions options;
+    options.LazyCompilation = true;
+    JitInterpreter lazy(options);
+
+    // Lazy definitions keep their AST, but not the source it was parsed
+    // from.
+    Arena arena;
+    for (const char *input :
+         {"def twice(x) helper(x) * 2", "def helper(x) x + 1",
+          "def broken(x) y"}) {
+        LexerImpl lexer{std::string(input)};
+        const BaseExpression *definition =
+            ParseNextExpression(&lexer, &arena, &lazy.GetSymbolTable());
+        ASSERT_NE(nullptr, definition);
+        EXPECT_EQ(std::nullopt, lazy.EvaluateExpression(definition));
+    }
+
+    // `twice` refers to a function defined after it, which is fine as long
+    // as it is defined by the time of the first call. `broken` is never
+    // called, so it is never compiled either.
+    EXPECT_EQ(std::optional<double>(8), Evaluate(lazy, "twice(3)"));
+    EXPECT_EQ(std::optional<double>(4), Evaluate(lazy, "helper(3)"));
+
+    // Compilation errors only show up on the first call.
+    std::optional<double> broken = Evaluate(lazy, "broken(1)");
+    ASSERT_TRUE(broken);
+    EXPECT_TRUE(std::isnan(*broken));
+}
+
+TEST_F(JitInterpreterTest, TieredExecution)
+{
+    JitOptions options;
+    options.TierUpThreshold = 2;
+    JitInterpreter tiered(options);
+
+    // Definitions are interpreted until they are compiled, so their ASTs
+    // must stay alive.
+    Arena arena;
+    for (const char *input :
+         {"extern cos(x)", "def sq(x) x * x", "def f(x) sq(x) + cos(0) + 1",
+          "def broken(x) y",
+          "def sum(a b c d e f g h i j) "
+          "a + b + c + d + e + f + g + h + i + j"}) {
+        LexerImpl lexer{std::string(input)};
+        const BaseExpression *item =
+            ParseNextExpression(&lexer, &arena, &tiered.GetSymbolTable());
+        ASSERT_NE(nullptr, item);
+        EXPECT_EQ(std::nullopt, tiered.EvaluateExpression(item));
+    }
+
+    // `f` and `sq` run in the interpreter twice, the third call compiles
+    // both of them.
+    for (int call = 0; call < 3; ++call) {
+        EXPECT_EQ(std::optional<double>(11), Evaluate(tiered, "f(3)"));
+    }
+    TierStats stats = tiered.GetTierStats();
+    EXPECT_EQ(4u, stats.InterpretedCalls);
+    EXPECT_EQ(2u, stats.CompiledFunctions);
+    EXPECT_EQ(std::optional<double>(16), Evaluate(tiered, "sq(4)"));
+    EXPECT_EQ(4u, tiered.GetTierStats().InterpretedCalls);
+
+    // Calls of any arity reach compiled code.
+    for (int call = 0; call < 3; ++call) {
+        EXPECT_EQ(std::optional<double>(55),
+                  Evaluate(tiered, "sum(1, 2, 3, 4, 5, 6, 7, 8, 9, 10)"));
+    }
+    EXPECT_EQ(3u, tiered.GetTierStats().CompiledFunctions);
+
+    // Errors show up on every call, and broken functions are never
+    // compiled.
+    for (int call = 0; call < 3; ++call) {
+        EXPECT_EQ(std::nullopt, Evaluate(tiered, "broken(1)"));
+    }
+    EXPECT_EQ(std::nullopt, Evaluate(tiered, "undefined(1)"));
+    EXPECT_EQ(3u, tiered.GetTierStats().CompiledFunctions);
+}
+
+TEST_F(JitInterpreterTest, TieredUnitAgreesWithCompiledUnit)
+{
+    const std::string source =
+        "def a(x) b(x) * 2 def b(x) x + 1 extern sqrt(x) "
+        "a(1) a(2) a(3) sqrt(a(0)) b(a(4))";
+    JitOptions options;
+    options.TierUpThreshold = 1;
+    JitInterpreter tiered(options);
+    LexerImpl tiered_lexer{std::string(source)};
+    const CompilationUnit unit =
+        ParseCompilationUnit(&tiered_lexer, &tiered.GetSymbolTable());
+
+    LexerImpl lexer{std::string(source)};
+    EXPECT_EQ(interpreter_.EvaluateUnit(
+                  ParseCompilationUnit(&lexer, &interpreter_.GetSymbolTable())),
+              tiered.EvaluateUnit(unit));
+    EXPECT_EQ(2u, tiered.GetTierStats().CompiledFunctions);
+}
+
+TEST_F(JitInterpreterTest, EvaluateBatch)
+{
+    // The ASTs are gone by the time the batches are compiled.
+    for (const char *input :
+         {"def sq(x) x * x", "def f(a b) sq(a) + b * 2", "extern fabs(x)",
+          "def g(x) fabs(x) - 1", "def k() 4"}) {
+        EXPECT_EQ(std::nullopt, Evaluate(interpreter_, input));
+    }
+
+    // An odd row count leaves a remainder after the vector loop.
+    const size_t rows = 1003;
+    std::vector<double> a(rows);
+    std::vector<double> b(rows);
+    for (size_t row = 0; row < rows; ++row) {
+        a[row] = static_cast<double>(row) - 500;
+        b[row] = static_cast<double>(row) / 4;
+    }
+    std::vector<double> out(rows);
+    ASSERT_TRUE(interpreter_.EvaluateBatch("f", {a.data(), b.data()}, rows,
+                                           out.data()));
+    for (size_t row = 0; row < rows; ++row) {
+        ASSERT_EQ(a[row] * a[row] + b[row] * 2, out[row]) << "row " << row;
+    }
+    // Compiled once, run again over part of the columns.
+    ASSERT_TRUE(interpreter_.EvaluateBatch("f", {b.data(), a.data()}, 3,
+                                           out.data()));
+    EXPECT_EQ(b[2] * b[2] + a[2] * 2, out[2]);
+
+    ASSERT_TRUE(interpreter_.EvaluateBatch("g", {a.data()}, rows, out.data()));
+    EXPECT_EQ(498, out[1]);
+    ASSERT_TRUE(interpreter_.EvaluateBatch("fabs", {a.data()}, rows,
+                                           out.data()));
+    EXPECT_EQ(500, out[0]);
+    ASSERT_TRUE(interpreter_.EvaluateBatch("k", {}, rows, out.data()));
+    EXPECT_EQ(4, out[rows - 1]);
+    EXPECT_TRUE(interpreter_.EvaluateBatch("f", {a.data(), b.data()}, 0,
+                                           nullptr));
+
+    EXPECT_FALSE(interpreter_.EvaluateBatch("undefined", {a.data()}, rows,
+                                            out.data()));
+    EXPECT_FALSE(interpreter_.EvaluateBatch("f", {a.data()}, rows,
+                                            out.data()));
+
+    // Lazy sessions compile batches from the same copies.
+    JitOptions options;
+    options.LazyCompilation = true;
+    JitInterpreter lazy(options);
+    EXPECT_EQ(std::nullopt, Evaluate(lazy, "def h(x) x * 3"));
+    EXPECT_EQ(std::nullopt, Evaluate(lazy, "def broken(x) y"));
+    ASSERT_TRUE(lazy.EvaluateBatch("h", {a.data()}, rows, out.data()));
+    EXPECT_EQ(-1500, out[0]);
+    EXPECT_FALSE(lazy.EvaluateBatch("broken", {a.data()}, rows, out.data()));
+}
+
+TEST_F(JitInterpreterTest, Memoization)
+{
+    JitOptions options;
+    options.MemoizedFunctions = {"sq", "f", "g"};
+    options.MemoTableSize = 5;
+    JitInterpreter memoized(options);
+    EXPECT_EQ(std::nullopt, Evaluate(memoized, "def sq(x) x * x"));
+    EXPECT_EQ(std::nullopt, Evaluate(memoized, "def f(x) sq(x) + sq(x + 1)"));
+
+    EXPECT_EQ(std::optional<double>(25), Evaluate(memoized, "f(3)"));
+    std::optional<MemoStats> stats = memoized.GetMemoStats("sq");
+    ASSERT_TRUE(stats);
+    EXPECT_EQ(0u, stats->Hits);
+    EXPECT_EQ(2u, stats->Misses);
+
+    // The second call never reaches `sq`.
+    EXPECT_EQ(std::optional<double>(25), Evaluate(memoized, "f(3)"));
+    EXPECT_EQ(1u, memoized.GetMemoStats("f")->Hits);
+    EXPECT_EQ(2u, memoized.GetMemoStats("sq")->Misses);
+    EXPECT_EQ(std::optional<double>(41), Evaluate(memoized, "f(4)"));
+    EXPECT_EQ(1u, memoized.GetMemoStats("sq")->Hits);
+
+    // Far more arguments than the 8 slots of the table evict each other,
+    // results stay right.
+    for (int x = 0; x < 64; ++x) {
+        const std::string call = fmt::format("f({})", x);
+        EXPECT_EQ(std::optional<double>(x * x + (x + 1) * (x + 1)),
+                  Evaluate(memoized, call.c_str()));
+    }
+
+    // A broken definition can be replaced by one of another arity.
+    EXPECT_EQ(std::nullopt, Evaluate(memoized, "def g(x) y"));
+    EXPECT_EQ(std::nullopt, Evaluate(memoized, "def g(x y) x * y"));
+    EXPECT_EQ(std::optional<double>(12),
+              Evaluate(memoized, "g(3, 4) + g(3, 2) - g(3, 2)"));
+    EXPECT_EQ(1u, memoized.GetMemoStats("g")->Hits);
+    EXPECT_EQ(2u, memoized.GetMemoStats("g")->Misses);
+    EXPECT_EQ(std::nullopt, memoized.GetMemoStats("undefined"));
+    EXPECT_EQ(std::nullopt, interpreter_.GetMemoStats("sq"));
+
+    // Lazy bodies are memoized just the same.
+    options.LazyCompilation = true;
+    JitInterpreter lazy(options);
+    Arena arena;
+    LexerImpl lexer{std::string("def sq(x) x * x")};
+    const BaseExpression *definition =
+        ParseNextExpression(&lexer, &arena, &lazy.GetSymbolTable());
+    ASSERT_NE(nullptr, definition);
+    EXPECT_EQ(std::nullopt, lazy.EvaluateExpression(definition));
+    EXPECT_EQ(std::optional<double>(18), Evaluate(lazy, "sq(3) + sq(3)"));
+    EXPECT_EQ(1u, lazy.GetMemoStats("sq")->Hits);
+}
+
+TEST_F(JitInterpreterTest, Redefinition)
+{
+    JitOptions options;
+    options.AllowRedefinition = true;
+    options.MemoizedFunctions = {"f"};
+    JitInterpreter session(options);
+    EXPECT_EQ(std::nullopt, Evaluate(session, "def f(x) x + 1"));
+    EXPECT_EQ(std::nullopt, Evaluate(session, "def g(x) f(x) * 2"));
+    EXPECT_EQ(std::optional<double>(8), Evaluate(session, "g(3)"));
+    std::vector<double> column = {1, 2, 3};
+    std::vector<double> out(column.size());
+    ASSERT_TRUE(
+        session.EvaluateBatch("g", {column.data()}, column.size(), out.data()));
+    EXPECT_EQ(8, out[2]);
+
+    // `g` is not compiled again, and the results cached for the old `f`
+    // are gone.
+    EXPECT_EQ(std::nullopt, Evaluate(session, "def f(x) x * 10"));
+    EXPECT_EQ(std::optional<double>(60), Evaluate(session, "g(3)"));
+    EXPECT_EQ(0u, session.GetMemoStats("f")->Hits);
+    EXPECT_EQ(1u, session.GetMemoStats("f")->Misses);
+    ASSERT_TRUE(
+        session.EvaluateBatch("g", {column.data()}, column.size(), out.data()));
+    EXPECT_EQ(60, out[2]);
+
+    // Failed and mismatched definitions leave the current one in place.
+    EXPECT_EQ(std::nullopt, Evaluate(session, "def f(x) y"));
+    EXPECT_EQ(std::nullopt, Evaluate(session, "def f(x y) x"));
+    EXPECT_EQ(std::optional<double>(60), Evaluate(session, "g(3)"));
+    EXPECT_EQ(std::nullopt, Evaluate(session, "extern fabs(x)"));
+    EXPECT_EQ(std::nullopt, Evaluate(session, "def fabs(x) x"));
+    EXPECT_EQ(std::optional<double>(2), Evaluate(session, "fabs(0 - 2)"));
+
+    // Callers may be defined before a body that compiles.
+    EXPECT_EQ(std::nullopt, Evaluate(session, "def h(x) y"));
+    EXPECT_EQ(std::nullopt, Evaluate(session, "def k(x) h(x) + 1"));
+    std::optional<double> broken = Evaluate(session, "k(1)");
+    ASSERT_TRUE(broken);
+    EXPECT_TRUE(std::isnan(*broken));
+    EXPECT_EQ(std::nullopt, Evaluate(session, "def h(x) x"));
+    EXPECT_EQ(std::optional<double>(2), Evaluate(session, "k(1)"));
+
+    // Within a unit, the last definition wins.
+    LexerImpl lexer(std::string("def g(x) 1 def g(x) f(x) + 2 g(1)"));
+    const std::vector<std::optional<double>> results = session.EvaluateUnit(
+        ParseCompilationUnit(&lexer, &session.GetSymbolTable()));
+    ASSERT_EQ(1u, results.size());
+    EXPECT_EQ(std::optional<double>(12), results[0]);
+
+    // Lazy versions are compiled on their first call.
+    options.LazyCompilation = true;
+    JitInterpreter lazy(options);
+    EXPECT_EQ(std::nullopt, Evaluate(lazy, "def f(x) x + 1"));
+    EXPECT_EQ(std::nullopt, Evaluate(lazy, "def g(x) f(x) * 2"));
+    EXPECT_EQ(std::optional<double>(8), Evaluate(lazy, "g(3)"));
+    EXPECT_EQ(std::nullopt, Evaluate(lazy, "def f(x) x * 10"));
+    EXPECT_EQ(std::optional<double>(60), Evaluate(lazy, "g(3)"));
+    EXPECT_EQ(std::optional<double>(60), Evaluate(lazy, "g(3)"));
+    EXPECT_EQ(1u, lazy.GetMemoStats("f")->Hits);
+
+    // Without the option, definitions are final.
+    EXPECT_EQ(std::nullopt, Evaluate(interpreter_, "def f(x) x + 1"));
+    EXPECT_EQ(std::nullopt, Evaluate(interpreter_, "def f(x) x * 10"));
+    EXPECT_EQ(std::optional<double>(2), Evaluate(interpreter_, "f(1)"));
+}
+
+TEST_F(JitInterpreterTest, NativeFunctionHandles)
+{
+    const std::vector<std::optional<double>> results =
+        interpreter_.EvaluateSource(
+            "extern fabs(x) def sq(x) x * x "
+            "def f(a b) sq(a) + fabs(b) f(2, 3) def k() 4");
+    ASSERT_EQ(1u, results.size());
+    EXPECT_EQ(std::optional<double>(7), results[0]);
+
+    auto* f = interpreter_.GetFunction<double(double, double)>("f");
+    ASSERT_NE(nullptr, f);
+    EXPECT_EQ(7, f(2, -3));
+    auto* k = interpreter_.GetFunction<double()>("k");
+    ASSERT_NE(nullptr, k);
+    EXPECT_EQ(4, k());
+    auto* fabs = interpreter_.GetFunction<double(double)>("fabs");
+    ASSERT_NE(nullptr, fabs);
+    EXPECT_EQ(2, fabs(-2));
+    EXPECT_EQ(nullptr, interpreter_.GetFunction<double(double)>("f"));
+    EXPECT_EQ(nullptr, interpreter_.GetFunction<double()>("undefined"));
+
+    // Handles need no synchronization, memoized functions included.
+    JitOptions options;
+    options.MemoizedFunctions = {"g"};
+    options.MemoTableSize = 16;
+    JitInterpreter memoized(options);
+    memoized.EvaluateSource("def g(a b) a * 1000 + b");
+    auto* g = memoized.GetFunction<double(double, double)>("g");
+    ASSERT_NE(nullptr, g);
+    std::vector<int> mismatches(4);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < mismatches.size(); ++t) {
+        threads.emplace_back([g, t, &mismatches] {
+            for (int i = 0; i < 20000; ++i) {
+                const double a = i % 64;
+                const double b = static_cast<double>(t);
+                if (g(a, b) != a * 1000 + b) ++mismatches[t];
+            }
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+    for (int count : mismatches) EXPECT_EQ(0, count);
+
+    // Lazy and tiered sessions keep the AST of the source themselves.
+    options = JitOptions();
+    options.LazyCompilation = true;
+    JitInterpreter lazy(options);
+    lazy.EvaluateSource("def h(x) x + 1 def broken(x) y");
+    auto* h = lazy.GetFunction<double(double)>("h");
+    ASSERT_NE(nullptr, h);
+    EXPECT_EQ(3, h(2));
+
+    options = JitOptions();
+    options.TierUpThreshold = 1000;
+    JitInterpreter tiered(options);
+    tiered.EvaluateSource("def h(x) x + 1 def broken(x) y");
+    h = tiered.GetFunction<double(double)>("h");
+    ASSERT_NE(nullptr, h);
+    EXPECT_EQ(3, h(2));
+    EXPECT_EQ(1u, tiered.GetTierStats().CompiledFunctions);
+    EXPECT_EQ(nullptr, tiered.GetFunction<double(double)>("broken"));
+}
+
+TEST_F(JitInterpreterTest, FastMath)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    // Code is compiled for the host, which must have FMA to fuse anything.
+    if (!__builtin_cpu_supports("fma")) GTEST_SKIP() << "No FMA on this CPU";
+#endif
+    // a * a needs 55 bits: rounded, the product equals c and the
+    // difference is 0. Fused, the difference is exact.
+    const char* source =
+        "def f(a b c) a * b - c def exact(a b c) a * b - c "
+        "def g(a b c) f(a, b, c)";
+    const double a = 134217729;  // 2^27 + 1
+    const double c = 18014398777917440;  // 2^54 + 2^28
+
+    interpreter_.EvaluateSource(source);
+    EXPECT_EQ(0, interpreter_.GetFunction<double(double, double, double)>(
+                     "f")(a, a, c));
+
+    JitOptions options;
+    options.FastMath.Contract = true;
+    options.FunctionFastMath["exact"] = FastMathFlags();
+    JitInterpreter fast(options);
+    fast.EvaluateSource(source);
+    EXPECT_EQ(1, fast.GetFunction<double(double, double, double)>("f")(
+                     a, a, c));
+    EXPECT_EQ(0, fast.GetFunction<double(double, double, double)>("exact")(
+                     a, a, c));
+
+    // Batch loops inline their own copy of `f`, flags included.
+    const std::vector<double> column_a = {a, 3};
+    const std::vector<double> column_c = {c, 1};
+    std::vector<double> out(2);
+    ASSERT_TRUE(fast.EvaluateBatch(
+        "g", {column_a.data(), column_a.data(), column_c.data()}, 2,
+        out.data()));
+    EXPECT_EQ(1, out[0]);
+    EXPECT_EQ(8, out[1]);
+}
+
+TEST_F(JitInterpreterTest, InlineAcrossItems)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (!__builtin_cpu_supports("fma")) GTEST_SKIP() << "No FMA on this CPU";
+#endif
+    // As in FastMath, but the product and the difference are in different
+    // functions: they only fuse once `mul` is inlined into its caller.
+    const double a = 134217729;
+    const double c = 18014398777917440;
+    auto fused = [&](JitOptions options, const char* caller) {
+        options.FastMath.Contract = true;
+        JitInterpreter session(options);
+        EXPECT_EQ(std::nullopt, Evaluate(session, "def mul(a b) a * b"));
+        EXPECT_EQ(std::nullopt, Evaluate(session, "def sub(a c) a - c"));
+        EXPECT_EQ(std::nullopt, Evaluate(session, caller));
+        auto* f = session.GetFunction<double(double, double, double)>("f");
+        return f && f(a, a, c) == 1;
+    };
+    const char* caller = "def f(a b c) mul(a, b) - c";
+    // Copies go through callees of callees.
+    const char* chain = "def f(a b c) sub(mul(a, b), c)";
+
+    JitOptions options;
+    EXPECT_FALSE(fused(options, caller));
+    options.InlineThreshold = 3;
+    EXPECT_TRUE(fused(options, caller));
+    EXPECT_TRUE(fused(options, chain));
+    options.OptLevel = OptimizationLevel::kO2;
+    EXPECT_TRUE(fused(options, chain));
+    options.CompileThreads = 2;
+    EXPECT_TRUE(fused(options, chain));
+    options = JitOptions();
+    options.InlineThreshold = 3;
+    options.LazyCompilation = true;
+    EXPECT_TRUE(fused(options, chain));
+
+    // `mul` has three nodes.
+    options = JitOptions();
+    options.InlineThreshold = 2;
+    EXPECT_FALSE(fused(options, caller));
+    options.InlineThreshold = 3;
+    options.MemoizedFunctions = {"mul"};
+    EXPECT_FALSE(fused(options, caller));
+    options = JitOptions();
+    options.InlineThreshold = 3;
+    options.AllowRedefinition = true;
+    EXPECT_FALSE(fused(options, caller));
+
+    // Top-level expressions inline their callees too, and a broken callee
+    // is called rather than copied.
+    options = JitOptions();
+    options.InlineThreshold = 3;
+    JitInterpreter session(options);
+    EXPECT_EQ(std::nullopt, Evaluate(session, "def mul(a b) a * b"));
+    EXPECT_EQ(std::nullopt, Evaluate(session, "def broken(x) y"));
+    EXPECT_EQ(std::optional<double>(12), Evaluate(session, "mul(3, 4)"));
+    EXPECT_EQ(std::nullopt, Evaluate(session, "broken(1)"));
+    EXPECT_EQ(std::nullopt, Evaluate(session, "def broken(x) mul(x, x)"));
+    EXPECT_EQ(std::optional<double>(9), Evaluate(session, "broken(3)"));
+}
+
+TEST_F(JitInterpreterTest, ObjectCacheSkipsCodegenOnWarmStart)
+{
+    const std::filesystem::path cache_dir =
+        std::filesystem::temp_directory_path() /
+        ::testing::UnitTest::GetInstance()->current_test_info()->name();
+    std::filesystem::remove_all(cache_dir);
+
+    JitOptions options;
+    options.ObjectCacheDirectory = cache_dir.string();
+    for (size_t expected_hits : {0, 1}) {
+        JitInterpreter cached(options);
+        EXPECT_EQ(std::nullopt, Evaluate(cached, "def cube(x) x * x * x"));
+        EXPECT_EQ(std::optional<double>(27), Evaluate(cached, "cube(3)"));
+
+        // Top-level expressions are never cached, only the definition.
+        const ObjectCacheStats stats = cached.GetObjectCacheStats();
+        EXPECT_EQ(expected_hits, stats.Hits);
+        EXPECT_EQ(1 - expected_hits, stats.Misses);
+    }
+
+    std::filesystem::remove_all(cache_dir);
+}
+
+TEST_F(JitInterpreterTest, TimeTraceRecordsEveryPhase)
+{
+    const std::filesystem::path trace_file =
+        std::filesystem::temp_directory_path() / "kaleidoscope_trace.json";
+
+    // Nothing recorded, nothing to write.
+    EXPECT_FALSE(kaleidoscope::time_trace::Finish(trace_file.string()));
+
+    kaleidoscope::time_trace::Begin(0);
+    JitOptions options;
+    options.OptLevel = OptimizationLevel::kO1;
+    JitInterpreter traced(options);
+    EXPECT_EQ(std::nullopt, Evaluate(traced, "def sq(x) x * x"));
+    EXPECT_EQ(std::optional<double>(9), Evaluate(traced, "sq(3)"));
+    ASSERT_TRUE(kaleidoscope::time_trace::Finish(trace_file.string()));
+
+    std::ifstream stream(trace_file);
+    const std::string trace((std::istreambuf_iterator<char>(stream)),
+                            std::istreambuf_iterator<char>());
+    for (const char *phase : {"Lex", "ParseItem", "GenerateIR", "Optimize",
+                              "CodeGen", "Compile", "Run"}) {
+        EXPECT_NE(std::string::npos,
+                  trace.find(fmt::format("\"Total {}\"", phase)))
+            << phase;
+    }
+
+    std::filesystem::remove(trace_file);
+}
@@ -1,15 +1,23 @@
 #include "kaleidoscope/lexer_impl.h"
 
+#include "kaleidoscope/char_scanner.h"
 #include "kaleidoscope/lexer_error.h"
+#include "kaleidoscope/source_buffer.h"
 #include "kaleidoscope/token.h"
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
 #include <utility>
 
 #include "mock_lexer.h"
 
 using kaleidoscope::LexerImpl;
+namespace scanner = kaleidoscope::scanner;
+using kaleidoscope::SourceBuffer;
 using kaleidoscope::Token;
 using kaleidoscope::TokenType;
 using kaleidoscope::LexerError;
@@ -97,6 +105,129 @@ TEST_F(LexerTest, ParseCharTokens)
                                {TokenType::kDot, "."sv}});
 }
 
+TEST_F(LexerTest, KeywordPrefixesAreIdentifiers)
+{
+    const char *input = "de define externs ex d e";
+    TokensInLexerMatch(input, {{TokenType::kIdentifier, "de"sv},
+                               {TokenType::kIdentifier, "define"sv},
+                               {TokenType::kIdentifier, "externs"sv},
+                               {TokenType::kIdentifier, "ex"sv},
+                               {TokenType::kIdentifier, "d"sv},
+                               {TokenType::kIdentifier, "e"sv}});
+}
+
+TEST_F(LexerTest, LongRunsCrossVectorBoundaries)
+{
+    const std::string identifier = "x" + std::string(70, 'a') + "Z9";
+    const std::string number(67, '7');
+    const std::string input = std::string(45, ' ') + identifier +
+                              std::string(33, '\n') + number + "\t(";
+    TokensInLexerMatch(input.c_str(),
+                       {{TokenType::kIdentifier, identifier},
+                        {TokenType::kNumber, number},
+                        {TokenType::kLeftParen, "("sv}});
+}
+
+TEST_F(LexerTest, NonAsciiBytesAreErrors)
+{
+    LexerImpl lexer(std::string("ab \xe9"));
+    lexer.ConsumeToken();
+    EXPECT_FALSE(lexer.PeekToken());
+}
+
+TEST_F(LexerTest, ConsumingAnErrorSkipsTheCharacter)
+{
+    LexerImpl lexer(std::string("ab  $$x"));
+    EXPECT_EQ(0u, lexer.GetOffset());
+    lexer.ConsumeToken();
+    EXPECT_FALSE(lexer.PeekToken());
+    EXPECT_EQ(4u, lexer.GetOffset());
+    lexer.ConsumeToken();
+    EXPECT_FALSE(lexer.PeekToken());
+    EXPECT_EQ(5u, lexer.GetOffset());
+    lexer.ConsumeToken();
+    ASSERT_TRUE(lexer.PeekToken());
+    EXPECT_EQ("x", lexer.PeekToken()->Value);
+    EXPECT_EQ(6u, lexer.GetOffset());
+    lexer.ConsumeToken();
+    EXPECT_EQ(TokenType::kEof, lexer.PeekToken()->Type);
+    EXPECT_EQ(lexer.GetSource().size(), lexer.GetOffset());
+}
+
+TEST_F(LexerTest, VectorKernelsMatchScalarKernels)
+{
+    // Every byte value, in runs long enough to cover the vector loops, their
+    // tails, and every position of the first mismatch.
+    const scanner::Kernels &scalar = scanner::ScalarKernels();
+    for (const scanner::Kernels *kernels : scanner::SupportedKernels()) {
+        SCOPED_TRACE(kernels->Name);
+        for (int byte = 0; byte < 256; ++byte) {
+            for (size_t run = 0; run < 70; ++run) {
+                std::string input(run, ' ');
+                std::fill_n(input.begin(), run / 2, '5');
+                input.push_back(static_cast<char>(byte));
+                input.append(40, 'a');
+                for (const std::string_view rest :
+                     {std::string_view(input),
+                      std::string_view(input).substr(run / 2)}) {
+                    const char *begin = rest.data();
+                    const char *end = begin + rest.size();
+                    ASSERT_EQ(scalar.SkipWhitespace(begin, end),
+                              kernels->SkipWhitespace(begin, end));
+                    ASSERT_EQ(scalar.SkipAlphaNumeric(begin, end),
+                              kernels->SkipAlphaNumeric(begin, end));
+                    ASSERT_EQ(scalar.SkipDigits(begin, end),
+                              kernels->SkipDigits(begin, end));
+                }
+            }
+        }
+    }
+}
+
+TEST_F(LexerTest, LexMappedFile)
+{
+    const std::filesystem::path path =
+        std::filesystem::temp_directory_path() / "kaleidoscope_lexer_test.ks";
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "def f(x) x * 2\nf(21)";
+    }
+
+    tl::expected<SourceBuffer, std::error_code> source =
+        SourceBuffer::FromFile(path.string());
+    ASSERT_TRUE(source);
+    EXPECT_TRUE(source->IsMapped());
+
+    LexerImpl lexer(std::move(*source));
+    const std::vector<Token> expected_tokens = {
+        {TokenType::kDef, "def"sv},        {TokenType::kIdentifier, "f"sv},
+        {TokenType::kLeftParen, "("sv},    {TokenType::kIdentifier, "x"sv},
+        {TokenType::kRightParen, ")"sv},   {TokenType::kIdentifier, "x"sv},
+        {TokenType::kAsterisk, "*"sv},     {TokenType::kNumber, "2"sv},
+        {TokenType::kIdentifier, "f"sv},   {TokenType::kLeftParen, "("sv},
+        {TokenType::kNumber, "21"sv},      {TokenType::kRightParen, ")"sv},
+        {TokenType::kEof, ""sv}};
+    for (const Token &expected_token : expected_tokens) {
+        const tl::expected<Token, LexerError> actual_token = lexer.PeekToken();
+        ASSERT_TRUE(actual_token);
+        EXPECT_EQ(expected_token.Type, actual_token->Type);
+        EXPECT_EQ(expected_token.Value, actual_token->Value);
+        lexer.ConsumeToken();
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST_F(LexerTest, SourceBufferFallbacks)
+{
+    EXPECT_FALSE(SourceBuffer::FromFile("/nonexistent/input.ks"));
+
+    SourceBuffer source = SourceBuffer::FromString("1 + 2");
+    EXPECT_FALSE(source.IsMapped());
+    SourceBuffer moved = std::move(source);
+    EXPECT_EQ("1 + 2"sv, moved.Contents());
+}
+
 int main(int argc, char **argv)
 {
     ::testing::InitGoogleTest(&argc, argv);
@@ -13,6 +13,8 @@ class MockLexer : public Lexer
    public:
     MOCK_METHOD((tl::expected<Token, LexerError>), PeekToken, (), (override));
     MOCK_METHOD(void, ConsumeToken, (), (override));
+    MOCK_METHOD(size_t, GetOffset, (), (override));
+    MOCK_METHOD(std::string_view, GetSource, (), (const, override));
 };
 }  // namespace kaleidoscope
 #endif  // TESTS_MOCK_LEXER_H
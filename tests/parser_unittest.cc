@@ -0,0 +1,225 @@
+#include "kaleidoscope/parser.h"
+
+#include "kaleidoscope/ast/arena.h"
+#include "kaleidoscope/ast/compilation_unit.h"
+#include "kaleidoscope/ast/fn.h"
+#include "kaleidoscope/ast/fn_prototype.h"
+#include "kaleidoscope/lexer_impl.h"
+#include "kaleidoscope/symbol_table.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+using kaleidoscope::Diagnostic;
+using kaleidoscope::DiagnosticCode;
+using kaleidoscope::DiagnosticSeverity;
+using kaleidoscope::FormatDiagnostic;
+using kaleidoscope::LexerImpl;
+using kaleidoscope::SymbolTable;
+using kaleidoscope::ast::Arena;
+using kaleidoscope::ast::CompilationUnit;
+using kaleidoscope::ast::dyn_cast;
+using kaleidoscope::ast::Fn;
+using kaleidoscope::ast::FnPrototype;
+using kaleidoscope::parser::ParseCompilationUnit;
+using kaleidoscope::parser::ParseCompilationUnitInParallel;
+using kaleidoscope::parser::ParseNextExpression;
+
+class ParserTest : public ::testing::Test
+{
+   protected:
+    SymbolTable symbols_;
+};
+
+TEST_F(ParserTest, ParseEveryItemOfALine)
+{
+    LexerImpl lexer(std::string("def f(x) x + 1 extern sin(a) f(2) 3 * 4"));
+    const CompilationUnit unit = ParseCompilationUnit(&lexer, &symbols_);
+    ASSERT_EQ(4u, unit.Items.size());
+
+    const auto* definition = dyn_cast<Fn>(unit.Items[0]);
+    ASSERT_NE(nullptr, definition);
+    EXPECT_EQ("f", definition->Proto->Name.GetSpelling());
+
+    const auto* extern_proto =
+        dyn_cast<FnPrototype>(unit.Items[1]);
+    ASSERT_NE(nullptr, extern_proto);
+    EXPECT_EQ("sin", extern_proto->Name.GetSpelling());
+    ASSERT_EQ(1u, extern_proto->Args.size());
+    EXPECT_EQ("a", extern_proto->Args[0].GetSpelling());
+}
+
+TEST_F(ParserTest, ResumeAtTheNextItem)
+{
+    LexerImpl lexer(
+        std::string("def (x) 1 + 2\ng(4) def g(x) x\nextern h(a"));
+    std::vector<Diagnostic> diagnostics;
+    const CompilationUnit unit =
+        ParseCompilationUnit(&lexer, &symbols_, &diagnostics);
+    // The rest of the broken definition is skipped along with it, and so is
+    // the call after it.
+    ASSERT_EQ(1u, unit.Items.size());
+    EXPECT_EQ("g", dyn_cast<Fn>(unit.Items[0])->Proto->Name.GetSpelling());
+
+    ASSERT_EQ(3u, diagnostics.size());
+    EXPECT_EQ(DiagnosticCode::kExpectedFunctionName, diagnostics[0].Code);
+    EXPECT_EQ(DiagnosticSeverity::kError, diagnostics[0].Severity);
+    EXPECT_EQ(4u, diagnostics[0].Offset);
+    EXPECT_EQ(1u, diagnostics[0].Line);
+    EXPECT_EQ(5u, diagnostics[0].Column);
+    EXPECT_EQ("1:5: error: Expected function name in prototype "
+              "[expected-function-name]",
+              FormatDiagnostic(diagnostics[0]));
+    // What was skipped is not lost silently.
+    EXPECT_EQ(DiagnosticCode::kSkippedTokens, diagnostics[1].Code);
+    EXPECT_EQ(DiagnosticSeverity::kNote, diagnostics[1].Severity);
+    EXPECT_EQ("1:5: note: Skipped 10 tokens up to the next def or extern, "
+              "they were not checked [skipped-tokens]",
+              FormatDiagnostic(diagnostics[1]));
+    // Errors at the end of the input point right past it, and skip nothing.
+    EXPECT_EQ(DiagnosticCode::kExpectedRightParen, diagnostics[2].Code);
+    EXPECT_EQ(40u, diagnostics[2].Offset);
+    EXPECT_EQ(3u, diagnostics[2].Line);
+    EXPECT_EQ(11u, diagnostics[2].Column);
+}
+
+TEST_F(ParserTest, ContinuePastLexerErrors)
+{
+    LexerImpl lexer(std::string("1 + 2 3 $ 4\n\ndef f(x) x @ 1 extern g(a)"));
+    std::vector<Diagnostic> diagnostics;
+    const CompilationUnit unit =
+        ParseCompilationUnit(&lexer, &symbols_, &diagnostics);
+    // The items that run into an error are dropped as well.
+    ASSERT_EQ(2u, unit.Items.size());
+    EXPECT_NE(nullptr, dyn_cast<FnPrototype>(unit.Items[1]));
+
+    // Each error is followed by a note on the bad character and the number
+    // after it.
+    ASSERT_EQ(4u, diagnostics.size());
+    for (size_t i = 0; i < diagnostics.size(); i += 2) {
+        EXPECT_EQ(DiagnosticCode::kUnknownCharacter, diagnostics[i].Code);
+        EXPECT_EQ(DiagnosticCode::kSkippedTokens, diagnostics[i + 1].Code);
+        EXPECT_EQ(diagnostics[i].Offset, diagnostics[i + 1].Offset);
+        EXPECT_NE(std::string::npos,
+                  diagnostics[i + 1].Message.find("Skipped 2 tokens"));
+    }
+    EXPECT_EQ(1u, diagnostics[0].Line);
+    EXPECT_EQ(9u, diagnostics[0].Column);
+    EXPECT_EQ(3u, diagnostics[2].Line);
+    EXPECT_EQ(12u, diagnostics[2].Column);
+}
+
+TEST_F(ParserTest, ReportEveryKindOfSyntaxError)
+{
+    const std::vector<std::pair<std::string, DiagnosticCode>> cases = {
+        {"extern f x)", DiagnosticCode::kExpectedLeftParen},
+        {"extern f(x 1)", DiagnosticCode::kExpectedRightParen},
+        {"1 + )", DiagnosticCode::kExpectedExpression},
+        {"(1 + 2", DiagnosticCode::kExpectedRightParen},
+        {"f(1 2)", DiagnosticCode::kExpectedCommaOrRightParen},
+        {"1 + 9" + std::string(400, '9'), DiagnosticCode::kInvalidNumber},
+    };
+    for (const auto& [source, code] : cases) {
+        SCOPED_TRACE(source);
+        LexerImpl lexer{std::string(source)};
+        Arena arena;
+        std::vector<Diagnostic> diagnostics;
+        EXPECT_EQ(nullptr,
+                  ParseNextExpression(&lexer, &arena, &symbols_, &diagnostics));
+        ASSERT_FALSE(diagnostics.empty());
+        EXPECT_EQ(code, diagnostics[0].Code);
+        // Anything else only notes what was skipped.
+        for (size_t i = 1; i < diagnostics.size(); ++i) {
+            EXPECT_EQ(DiagnosticSeverity::kNote, diagnostics[i].Severity);
+        }
+    }
+}
+
+TEST_F(ParserTest, AllocateNodesFromTheUnitArena)
+{
+    LexerImpl lexer(std::string("def f(x y) x * g(y, 1) f(1, 2)"));
+    CompilationUnit unit = ParseCompilationUnit(&lexer, &symbols_);
+    ASSERT_EQ(2u, unit.Items.size());
+    EXPECT_LT(0u, unit.Nodes.BytesUsed());
+
+    // Moving the unit keeps every node in place.
+    const auto* definition = unit.Items[0];
+    const CompilationUnit moved = std::move(unit);
+    EXPECT_EQ(definition, moved.Items[0]);
+    std::string printed;
+    moved.Items[0]->PrintToString(printed);
+    EXPECT_NE(std::string::npos, printed.find("callee=g"));
+}
+
+TEST_F(ParserTest, ArenaAlignsEveryAllocation)
+{
+    Arena arena;
+    arena.New<char>('a');
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(arena.New<double>(1.0)) %
+                      alignof(double));
+
+    // Arrays larger than a chunk get one of their own.
+    const std::vector<uint64_t> large(10000, 7);
+    const auto copy = arena.CopyArray(large);
+    ASSERT_EQ(large.size(), copy.size());
+    EXPECT_EQ(7u, copy[large.size() - 1]);
+    EXPECT_TRUE(arena.CopyArray(std::vector<int>()).empty());
+}
+
+TEST_F(ParserTest, ParseInParallelMatchesSequentialParse)
+{
+    // Large enough to be split into several pieces. Names that merely
+    // contain the keywords must not be taken for item boundaries.
+    std::string source;
+    for (int i = 0; i < 5000; ++i) {
+        source += "def undef" + std::to_string(i) + "(x) x * defx(x + " +
+                  std::to_string(i) + ")\nextern defx(a) undef0(1)\n";
+        // Broken up to the next item.
+        if (i % 10 == 0) source += "def broken(x) (x + 1\n";
+    }
+    source += "extern last(x) $ def reached(x) x";
+
+    LexerImpl lexer{std::string(source)};
+    std::vector<Diagnostic> sequential_diagnostics;
+    const CompilationUnit sequential =
+        ParseCompilationUnit(&lexer, &symbols_, &sequential_diagnostics);
+    std::vector<Diagnostic> parallel_diagnostics;
+    const CompilationUnit parallel = ParseCompilationUnitInParallel(
+        source, &symbols_, 4, &parallel_diagnostics);
+
+    // Both resume after the errors, and report them at the same places.
+    ASSERT_EQ(15002u, sequential.Items.size());
+    ASSERT_EQ(sequential.Items.size(), parallel.Items.size());
+    for (size_t i = 0; i < sequential.Items.size(); ++i) {
+        ASSERT_EQ(sequential.Items[i]->GetKind(), parallel.Items[i]->GetKind())
+            << i;
+        if (const auto* definition = dyn_cast<Fn>(sequential.Items[i])) {
+            EXPECT_EQ(definition->Proto->Name,
+                      dyn_cast<Fn>(parallel.Items[i])->Proto->Name);
+        }
+    }
+    EXPECT_EQ(sequential.Nodes.BytesUsed(), parallel.Nodes.BytesUsed());
+
+    // An error for each broken definition, which skips nothing, and one
+    // along with its note for the unknown character.
+    ASSERT_EQ(502u, sequential_diagnostics.size());
+    ASSERT_EQ(sequential_diagnostics.size(), parallel_diagnostics.size());
+    for (size_t i = 0; i < sequential_diagnostics.size(); ++i) {
+        EXPECT_EQ(sequential_diagnostics[i].Code, parallel_diagnostics[i].Code);
+        EXPECT_EQ(sequential_diagnostics[i].Message,
+                  parallel_diagnostics[i].Message);
+        EXPECT_EQ(sequential_diagnostics[i].Offset,
+                  parallel_diagnostics[i].Offset);
+        EXPECT_EQ(sequential_diagnostics[i].Line, parallel_diagnostics[i].Line);
+        EXPECT_EQ(sequential_diagnostics[i].Column,
+                  parallel_diagnostics[i].Column);
+    }
+    EXPECT_EQ(DiagnosticCode::kUnknownCharacter,
+              sequential_diagnostics[500].Code);
+    EXPECT_EQ(DiagnosticCode::kSkippedTokens,
+              sequential_diagnostics.back().Code);
+}
@@ -0,0 +1,128 @@
+#include "kaleidoscope/simplifier.h"
+
+#include "kaleidoscope/ast/binary_op.h"
+#include "kaleidoscope/ast/compilation_unit.h"
+#include "kaleidoscope/ast/fn.h"
+#include "kaleidoscope/ast/fn_call.h"
+#include "kaleidoscope/ast/number.h"
+#include "kaleidoscope/ast/variable.h"
+#include "kaleidoscope/lexer_impl.h"
+#include "kaleidoscope/parser.h"
+#include "kaleidoscope/symbol_table.h"
+
+#include <gtest/gtest.h>
+
+#include <fmt/core.h>
+
+#include <string>
+#include <vector>
+
+using kaleidoscope::LexerImpl;
+using kaleidoscope::SymbolTable;
+using kaleidoscope::ast::BaseExpression;
+using kaleidoscope::ast::BinaryOp;
+using kaleidoscope::ast::CompilationUnit;
+using kaleidoscope::ast::dyn_cast;
+using kaleidoscope::ast::Fn;
+using kaleidoscope::ast::FnCall;
+using kaleidoscope::ast::Number;
+using kaleidoscope::ast::Variable;
+using kaleidoscope::parser::ParseCompilationUnit;
+using kaleidoscope::simplifier::SimplifyCompilationUnit;
+
+class SimplifierTest : public ::testing::Test
+{
+   protected:
+    CompilationUnit Parse(std::string input)
+    {
+        LexerImpl lexer(std::move(input));
+        return ParseCompilationUnit(&lexer, &symbols_);
+    }
+
+    // Parses a single item and simplifies it.
+    const BaseExpression* Simplify(std::string input)
+    {
+        units_.push_back(Parse(std::move(input)));
+        CompilationUnit& unit = units_.back();
+        if (unit.Items.size() != 1) return nullptr;
+        SimplifyCompilationUnit(&unit);
+        return unit.Items.front();
+    }
+
+    SymbolTable symbols_;
+    std::vector<CompilationUnit> units_;
+};
+
+TEST_F(SimplifierTest, FoldLiteralOperations)
+{
+    const auto* number = dyn_cast<Number>(Simplify("(1 + 2) * 3 - 4"));
+    ASSERT_NE(nullptr, number);
+    EXPECT_EQ(5, number->Value);
+}
+
+TEST_F(SimplifierTest, DropOperandsThatCannotChangeTheResult)
+{
+    for (const char* input : {"x * 1", "1 * x", "x - 0", "x + (0 - 1) * 0",
+                              "(0 - 1) * 0 + x", "(x * (2 - 1)) - (3 - 3)"}) {
+        const auto* variable = dyn_cast<Variable>(Simplify(input));
+        ASSERT_NE(nullptr, variable) << input;
+        EXPECT_EQ("x", variable->Name.GetSpelling());
+    }
+}
+
+TEST_F(SimplifierTest, KeepOperationsThatCanChangeTheResult)
+{
+    // x + 0 turns -0 into 0, x * 0 is not 0 for infinities and NaN, and
+    // 0 - x is not -x for x = 0.
+    for (const char* input : {"x + 0", "0 + x", "x * 0", "0 - x"}) {
+        EXPECT_NE(nullptr, dyn_cast<BinaryOp>(Simplify(input))) << input;
+    }
+}
+
+TEST_F(SimplifierTest, NeverReassociate)
+{
+    const auto* outer = dyn_cast<BinaryOp>(Simplify("x + 1 + 2"));
+    ASSERT_NE(nullptr, outer);
+    EXPECT_NE(nullptr, dyn_cast<BinaryOp>(outer->LhsOp));
+    EXPECT_NE(nullptr, dyn_cast<Number>(outer->RhsOp));
+}
+
+TEST_F(SimplifierTest, ShareUnchangedSubtrees)
+{
+    CompilationUnit unit = Parse("def f(x) g(x * y, 1 + 1) def h(x) x * y");
+    ASSERT_EQ(2u, unit.Items.size());
+    const auto* changed = dyn_cast<Fn>(unit.Items[0]);
+    const auto* unchanged = unit.Items[1];
+    ASSERT_NE(nullptr, changed);
+    const auto* call = dyn_cast<FnCall>(changed->Body);
+    ASSERT_NE(nullptr, call);
+    const auto* first_arg = call->Args[0];
+
+    SimplifyCompilationUnit(&unit);
+    EXPECT_EQ(unchanged, unit.Items[1]);
+    const auto* simplified = dyn_cast<Fn>(unit.Items[0]);
+    ASSERT_NE(nullptr, simplified);
+    EXPECT_NE(changed, simplified);
+    EXPECT_EQ(changed->Proto, simplified->Proto);
+    const auto* simplified_call = dyn_cast<FnCall>(simplified->Body);
+    ASSERT_NE(nullptr, simplified_call);
+    ASSERT_EQ(2u, simplified_call->Args.size());
+    EXPECT_EQ(first_arg, simplified_call->Args[0]);
+    EXPECT_NE(nullptr, dyn_cast<Number>(simplified_call->Args[1]));
+
+    // The original nodes are left untouched.
+    EXPECT_EQ(call, changed->Body);
+}
+
+TEST_F(SimplifierTest, FoldLongLiteralChains)
+{
+    // Deep enough to overflow the stack if the tree was walked recursively.
+    constexpr int kLiterals = 100000;
+    std::string input = "0";
+    for (int i = 1; i < kLiterals; ++i) input += fmt::format(" + {}", i);
+
+    const auto* number = dyn_cast<Number>(Simplify(std::move(input)));
+    ASSERT_NE(nullptr, number);
+    EXPECT_EQ(static_cast<double>(kLiterals) * (kLiterals - 1) / 2,
+              number->Value);
+}
@@ -0,0 +1,102 @@
+#include "kaleidoscope/symbol_table.h"
+
+#include "kaleidoscope/ast/compilation_unit.h"
+#include "kaleidoscope/ast/fn.h"
+#include "kaleidoscope/ast/fn_prototype.h"
+#include "kaleidoscope/lexer_impl.h"
+#include "kaleidoscope/parser.h"
+
+#include <gtest/gtest.h>
+
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using kaleidoscope::LexerImpl;
+using kaleidoscope::Symbol;
+using kaleidoscope::SymbolMap;
+using kaleidoscope::SymbolTable;
+using kaleidoscope::ast::CompilationUnit;
+using kaleidoscope::ast::Fn;
+using kaleidoscope::ast::cast;
+using kaleidoscope::parser::ParseCompilationUnit;
+
+class SymbolTableTest : public ::testing::Test
+{
+   protected:
+    SymbolTable symbols_;
+};
+
+TEST_F(SymbolTableTest, InternEachSpellingOnce)
+{
+    const Symbol foo = symbols_.Intern("foo");
+    const Symbol bar = symbols_.Intern("bar");
+    EXPECT_EQ(foo, symbols_.Intern(std::string("foo")));
+    EXPECT_NE(foo, bar);
+    EXPECT_EQ(0u, foo.GetId());
+    EXPECT_EQ(1u, bar.GetId());
+    EXPECT_EQ("bar", bar.GetSpelling());
+    EXPECT_EQ(2u, symbols_.GetSymbolCount());
+
+    EXPECT_EQ(foo, symbols_.Find("foo"));
+    EXPECT_FALSE(symbols_.Find("baz").IsValid());
+    EXPECT_FALSE(Symbol().IsValid());
+}
+
+TEST_F(SymbolTableTest, SymbolsOutliveTheirSource)
+{
+    CompilationUnit unit;
+    {
+        LexerImpl lexer(std::string("def longfunctionname(argument) argument"));
+        unit = ParseCompilationUnit(&lexer, &symbols_);
+    }
+    ASSERT_EQ(1u, unit.Items.size());
+    const Fn* definition = cast<Fn>(unit.Items[0]);
+    EXPECT_EQ("longfunctionname", definition->Proto->Name.GetSpelling());
+    EXPECT_EQ(symbols_.Find("argument"), definition->Proto->Args[0]);
+}
+
+TEST_F(SymbolTableTest, MapBySymbolId)
+{
+    SymbolMap<int> map;
+    const Symbol first = symbols_.Intern("first");
+    const Symbol second = symbols_.Intern("second");
+    EXPECT_FALSE(map.Contains(second));
+
+    map.Set(second, 2);
+    ASSERT_NE(nullptr, map.Find(second));
+    EXPECT_EQ(2, *map.Find(second));
+    EXPECT_EQ(nullptr, map.Find(first));
+
+    map.Erase(second);
+    map.Erase(symbols_.Intern("third"));
+    EXPECT_FALSE(map.Contains(second));
+}
+
+TEST_F(SymbolTableTest, FrontTablesInternIntoTheSharedTable)
+{
+    const Symbol existing = symbols_.Intern("existing");
+
+    std::vector<std::vector<Symbol>> interned(4);
+    std::vector<std::thread> threads;
+    for (std::vector<Symbol>& thread_symbols : interned) {
+        threads.emplace_back([this, &thread_symbols] {
+            SymbolTable front(&symbols_);
+            for (int i = 0; i < 1000; ++i) {
+                thread_symbols.push_back(
+                    front.Intern("name" + std::to_string(i % 100)));
+            }
+            thread_symbols.push_back(front.Intern("existing"));
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+
+    // Every thread got the same symbols, all owned by the shared table.
+    EXPECT_EQ(101u, symbols_.GetSymbolCount());
+    for (const std::vector<Symbol>& thread_symbols : interned) {
+        EXPECT_EQ(interned.front(), thread_symbols);
+        EXPECT_EQ(existing, thread_symbols.back());
+    }
+    EXPECT_EQ(interned.front()[42], symbols_.Find("name42"));
+}
@@ -0,0 +1,131 @@
+#include "kaleidoscope/vm_interpreter.h"
+
+#include "kaleidoscope/ast/arena.h"
+#include "kaleidoscope/ast/base_expression.h"
+#include "kaleidoscope/ast/compilation_unit.h"
+#include "kaleidoscope/lexer_impl.h"
+#include "kaleidoscope/parser.h"
+
+#include <fmt/core.h>
+#include <gtest/gtest.h>
+
+#include <optional>
+#include <string>
+#include <vector>
+
+using kaleidoscope::LexerImpl;
+using kaleidoscope::VmInterpreter;
+using kaleidoscope::ast::Arena;
+using kaleidoscope::ast::BaseExpression;
+using kaleidoscope::ast::CompilationUnit;
+using kaleidoscope::parser::ParseCompilationUnit;
+using kaleidoscope::parser::ParseNextExpression;
+
+namespace
+{
+std::optional<double> Evaluate(VmInterpreter &interpreter,
+                               const std::string &input)
+{
+    LexerImpl lexer{std::string(input)};
+    Arena arena;
+    const BaseExpression *expr =
+        ParseNextExpression(&lexer, &arena, &interpreter.GetSymbolTable());
+    if (!expr) return std::nullopt;
+    return interpreter.EvaluateExpression(expr);
+}
+}  // namespace
+
+class VmInterpreterTest : public ::testing::Test
+{
+   protected:
+    VmInterpreter interpreter_;
+};
+
+TEST_F(VmInterpreterTest, EvaluateTopLevelExpression)
+{
+    EXPECT_EQ(std::optional<double>(7), Evaluate(interpreter_, "1 + 2 * 3"));
+    EXPECT_EQ(std::optional<double>(-4), Evaluate(interpreter_, "(1 - 5)"));
+}
+
+TEST_F(VmInterpreterTest, CallDefinedFunction)
+{
+    EXPECT_EQ(std::nullopt, Evaluate(interpreter_, "def sq(x) x * x"));
+    EXPECT_EQ(std::nullopt, Evaluate(interpreter_, "def add(a b) a + sq(b)"));
+    EXPECT_EQ(std::optional<double>(11), Evaluate(interpreter_, "add(2, 3)"));
+    // Arguments are evaluated in place, nested calls included.
+    EXPECT_EQ(std::optional<double>(2 + 81 + 4),
+              Evaluate(interpreter_, "add(2, sq(3)) + sq(add(1, 1) - 0)"));
+}
+
+TEST_F(VmInterpreterTest, CallHostFunction)
+{
+    EXPECT_EQ(std::nullopt, Evaluate(interpreter_, "extern fabs(x)"));
+    EXPECT_EQ(std::nullopt, Evaluate(interpreter_, "extern pow(x y)"));
+    EXPECT_EQ(std::optional<double>(3), Evaluate(interpreter_, "fabs(1 - 4)"));
+    EXPECT_EQ(std::optional<double>(8), Evaluate(interpreter_, "pow(2, 3)"));
+}
+
+TEST_F(VmInterpreterTest, EvaluateUnit)
+{
+    LexerImpl lexer(std::string(
+        "def a(x) b(x) * 2 "
+        "a(1) "
+        "def b(x) x + c "
+        "def c(x) x + 1 "
+        "a(2) + b(3)"));
+    const CompilationUnit unit =
+        ParseCompilationUnit(&lexer, &interpreter_.GetSymbolTable());
+
+    // `b` refers to an unknown variable, and `a` calls it, neither runs.
+    const std::vector<std::optional<double>> results =
+        interpreter_.EvaluateUnit(unit);
+    ASSERT_EQ(2u, results.size());
+    EXPECT_EQ(std::nullopt, results[0]);
+    EXPECT_EQ(std::nullopt, results[1]);
+    EXPECT_EQ(std::optional<double>(3), Evaluate(interpreter_, "c(2)"));
+
+    // Broken functions can be defined again.
+    EXPECT_EQ(std::nullopt, Evaluate(interpreter_, "def a(x) c(x) * 2"));
+    EXPECT_EQ(std::optional<double>(6), Evaluate(interpreter_, "a(2)"));
+    EXPECT_EQ(std::nullopt, Evaluate(interpreter_, "def c(x) x"));
+    EXPECT_EQ(std::optional<double>(6), Evaluate(interpreter_, "a(2)"));
+
+    LexerImpl forward_lexer(std::string(
+        "def d(x) e(x) * 2 d(1) def e(x) x + 1 d(2) + e(3)"));
+    const std::vector<std::optional<double>> forward_results =
+        interpreter_.EvaluateUnit(ParseCompilationUnit(
+            &forward_lexer, &interpreter_.GetSymbolTable()));
+    ASSERT_EQ(2u, forward_results.size());
+    EXPECT_EQ(std::optional<double>(4), forward_results[0]);
+    EXPECT_EQ(std::optional<double>(10), forward_results[1]);
+}
+
+TEST_F(VmInterpreterTest, ReportErrors)
+{
+    EXPECT_EQ(std::nullopt, Evaluate(interpreter_, "undefined(1)"));
+    EXPECT_EQ(std::nullopt, Evaluate(interpreter_, "def bad(x) y"));
+    EXPECT_EQ(std::nullopt, Evaluate(interpreter_, "bad(1)"));
+    EXPECT_EQ(std::nullopt, Evaluate(interpreter_, "extern nosuchfunction(x)"));
+    EXPECT_EQ(std::nullopt, Evaluate(interpreter_, "nosuchfunction(1)"));
+
+    // Without branches, recursion never ends.
+    EXPECT_EQ(std::nullopt, Evaluate(interpreter_, "def loop(x) loop(x) + 1"));
+    EXPECT_EQ(std::nullopt, Evaluate(interpreter_, "loop(1)"));
+
+    // The interpreter is still usable after errors.
+    EXPECT_EQ(std::optional<double>(2), Evaluate(interpreter_, "1 + 1"));
+}
+
+TEST_F(VmInterpreterTest, DeepExpressions)
+{
+    // Each level keeps the left operand alive while the right one is
+    // computed, one register per level.
+    std::string nested = "x";
+    for (int i = 0; i < 200; ++i) nested = fmt::format("(1 + {})", nested);
+    EXPECT_EQ(std::nullopt, Evaluate(interpreter_, "def deep(x) " + nested));
+    EXPECT_EQ(std::optional<double>(201), Evaluate(interpreter_, "deep(1)"));
+
+    std::string chain = "0";
+    for (int i = 1; i <= 1000; ++i) chain += fmt::format(" + {}", i);
+    EXPECT_EQ(std::optional<double>(500500), Evaluate(interpreter_, chain));
+}